@@ -12,6 +12,8 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
+#include <cstdio>
 #include <map>
 #include <string>
 #include <vector>
@@ -27,6 +29,7 @@
 #include "interop-logging.h"
 #include "interop-utils.h"
 #include "koala-types.h"
+#include "peer-handles.h"
 
 #ifdef KOALA_FOREIGN_NAPI
 #ifndef KOALA_FOREIGN_NAPI_OHOS
@@ -39,9 +42,6 @@
 
 #if KOALA_INTEROP_PROFILER
 #include "profiler.h"
-
-InteropProfiler* InteropProfiler::_instance = nullptr;
-
 #endif
 
 using std::string;
@@ -174,6 +174,94 @@ KNativePointer impl_GetPtrVectorElement(KNativePointer ptr, KInt index)
 }
 KOALA_INTEROP_2(GetPtrVectorElement, KNativePointer, KNativePointer, KInt)
 
+#if KOALA_INTEROP_PROFILER
+void impl_ProfilerSetEnabled(KBoolean enabled)
+{
+    InteropProfiler::instance()->setEnabled(enabled != 0);
+}
+KOALA_INTEROP_V1(ProfilerSetEnabled, KBoolean)
+
+KStringPtr impl_ProfilerReport()
+{
+    auto report = InteropProfiler::instance()->report(INTEROP_PROFILER_TEXT);
+    return KStringPtr(report.c_str(), report.length(), true);
+}
+KOALA_INTEROP_0(ProfilerReport, KStringPtr)
+
+// Writes the report in the given InteropProfilerFormat to the file
+KBoolean impl_ProfilerDump(const KStringPtr& path, KInt format)
+{
+    auto report = InteropProfiler::instance()->report(static_cast<InteropProfilerFormat>(format));
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = fwrite(report.data(), 1, report.size(), file) == report.size();
+    return fclose(file) == 0 && written;
+}
+KOALA_INTEROP_2(ProfilerDump, KBoolean, KStringPtr, KInt)
+
+void impl_ProfilerReset()
+{
+    InteropProfiler::instance()->reset();
+}
+KOALA_INTEROP_V0(ProfilerReset)
+#endif
+
+#if KOALA_INTEROP_TRACER && !KOALA_INTEROP_PROFILER
+// Traces one call in `sampling` of the comma separated modules, all modules when empty
+KBoolean impl_TraceStart(const KStringPtr& path, KInt sampling, const KStringPtr& modules)
+{
+    return InteropTracer::instance()->start(path.c_str(), sampling > 0 ? sampling : 1, modules.c_str());
+}
+KOALA_INTEROP_3(TraceStart, KBoolean, KStringPtr, KInt, KStringPtr)
+
+void impl_TraceStop()
+{
+    InteropTracer::instance()->stop();
+}
+KOALA_INTEROP_V0(TraceStop)
+#endif
+
+static void DisposeHandleBuffer(KNativePointer data, KInt length)
+{
+    delete[] reinterpret_cast<int32_t*>(data);
+}
+
+// Same as GetPtrVector, but elements are peer handles owned by the scope
+KInteropReturnBuffer impl_GetPtrVectorHandles(KNativePointer scope, KNativePointer ptr)
+{
+    auto vectorPtr = reinterpret_cast<std::vector<void*>*>(ptr);
+    if (vectorPtr == nullptr) {
+        INTEROP_FATAL("GetPtrVectorHandles failed!")
+    }
+    auto* handles = PeerHandles::Instance();
+    auto* data = new int32_t[std::max<size_t>(vectorPtr->size(), 1)];
+    for (size_t i = 0; i < vectorPtr->size(); i++) {
+        data[i] = handles->Acquire(scope, (*vectorPtr)[i]);
+    }
+    return { static_cast<KInt>(vectorPtr->size()), data, DisposeHandleBuffer, sizeof(int32_t) };
+}
+KOALA_INTEROP_2(GetPtrVectorHandles, KInteropReturnBuffer, KNativePointer, KNativePointer)
+
+KInt impl_GetPeerHandle(KNativePointer scope, KNativePointer peer)
+{
+    return PeerHandles::Instance()->Acquire(scope, peer);
+}
+KOALA_INTEROP_2(GetPeerHandle, KInt, KNativePointer, KNativePointer)
+
+KNativePointer impl_ResolvePeerHandle(KInt handle)
+{
+    return PeerHandles::Instance()->Resolve(handle);
+}
+KOALA_INTEROP_1(ResolvePeerHandle, KNativePointer, KInt)
+
+void impl_ReleasePeerHandles(KNativePointer scope)
+{
+    PeerHandles::Instance()->Release(scope);
+}
+KOALA_INTEROP_V1(ReleasePeerHandles, KNativePointer)
+
 inline KUInt unpackUInt(const KByte* bytes)
 {
     return (bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24));
@@ -20,17 +20,33 @@
 
 #include "koala-types.h"
 
+#ifndef KOALA_INTEROP_PROFILER
 #define KOALA_INTEROP_PROFILER 0
+#endif
+#ifndef KOALA_INTEROP_TRACER
 #define KOALA_INTEROP_TRACER 0
+#endif
 
 #if KOALA_INTEROP_PROFILER
 #include "profiler.h"
-#define KOALA_INTEROP_LOGGER(name) InteropMethodCall logger(#name);
+#define KOALA_INTEROP_LOGGER(name)                                                                  \
+    static const int32_t name##ProfilerSlot = InteropProfiler::instance()->registerSlot(#name); \
+    InteropMethodCall logger(name##ProfilerSlot);
+#elif KOALA_INTEROP_TRACER
+#include "tracer.h"
+#define KOALA_INTEROP_TRACER_QUOTE2(x) #x
+#define KOALA_INTEROP_TRACER_QUOTE(x) KOALA_INTEROP_TRACER_QUOTE2(x)
+#define KOALA_INTEROP_LOGGER(name)                                                 \
+    static const int32_t name##TraceId = InteropTracer::instance()->registerBridge( \
+        KOALA_INTEROP_TRACER_QUOTE(KOALA_INTEROP_MODULE), #name);                  \
+    InteropMethodCall logger(name##TraceId);
 #endif
 
-#if KOALA_INTEROP_TRACER
-#include "tracer.h"
-#define KOALA_INTEROP_LOGGER(name) InteropMethodCall logger(#name);
+// Attaches a value (e.g. a hash of the arguments) to the innermost traced call
+#if KOALA_INTEROP_TRACER && !KOALA_INTEROP_PROFILER
+#define KOALA_INTEROP_TRACE_DIGEST(value) InteropTracer::digest(static_cast<uint64_t>(value))
+#else
+#define KOALA_INTEROP_TRACE_DIGEST(value)
 #endif
 
 #ifdef KOALA_INTEROP_LOGGER
@@ -12,12 +12,15 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <string>
 #include <vector>
 
 #include "interop-logging.h"
+#include "peer-handles.h"
 #undef KOALA_INTEROP_MODULE
 #define KOALA_INTEROP_MODULE InteropNativeModule
 #include "convertors-napi.h"
@@ -113,13 +116,62 @@ KStringPtr getString(napi_env env, napi_value value)
         return result;
     }
 
+    readString(env, value, result);
+    return result;
+}
+
+/*
+ * Strings are first copied into a growable per-thread scratch buffer, so that the
+ * common case needs a single napi call instead of one for the length and one for
+ * the data. The result is not left pointing into the scratch buffer: several string
+ * arguments of one call, or a nested callback, would overwrite each other. Short
+ * results are kept inline by KStringPtr.
+ */
+napi_status readString(napi_env env, napi_value value, KStringPtr& result)
+{
+    static constexpr size_t INITIAL_SCRATCH_SIZE = 256;
+    // A multibyte character that does not fit is dropped as a whole
+    static constexpr size_t UTF8_MAX_SEQUENCE = 4;
+    static thread_local std::vector<char> scratch(INITIAL_SCRATCH_SIZE);
+
     size_t length = 0;
-    napi_status status = napi_get_value_string_utf8(env, value, nullptr, 0, &length);
-    if (status != 0) {
-        return result;
+    napi_status status = napi_get_value_string_utf8(env, value, scratch.data(), scratch.size(), &length);
+    if (status != napi_ok) {
+        return status;
+    }
+    if (length + UTF8_MAX_SEQUENCE >= scratch.size()) {
+        // Possibly truncated, query the real length and retry once
+        status = napi_get_value_string_utf8(env, value, nullptr, 0, &length);
+        if (status != napi_ok) {
+            return status;
+        }
+        if (length + UTF8_MAX_SEQUENCE >= scratch.size()) {
+            scratch.resize(std::max(length + UTF8_MAX_SEQUENCE + 1, scratch.size() * 2));
+            status = napi_get_value_string_utf8(env, value, scratch.data(), scratch.size(), &length);
+            if (status != napi_ok) {
+                return status;
+            }
+        }
+    }
+    result.assign(scratch.data(), static_cast<int>(length));
+    return napi_ok;
+}
+
+napi_value createString(napi_env env, const char* data, size_t length)
+{
+    napi_value result;
+    if (data == nullptr) {
+        data = "";
+        length = 0;
     }
-    result.resize(length);
-    status = napi_get_value_string_utf8(env, value, result.data(), length + 1, nullptr);
+    bool ascii = true;
+    for (size_t i = 0; i < length && ascii; i++) {
+        ascii = static_cast<unsigned char>(data[i]) < 0x80;
+    }
+    // ASCII is valid latin1, which V8 stores as a one-byte string without UTF-8 decoding
+    napi_status status = ascii ? napi_create_string_latin1(env, data, length, &result)
+                               : napi_create_string_utf8(env, data, length, &result);
+    KOALA_NAPI_THROW_IF_FAILED(env, status, result);
     return result;
 }
 
@@ -133,6 +185,26 @@ KNativePointer getPointerSlow(napi_env env, napi_value value)
         return result;
     }
 
+    if (valueType == napi_valuetype::napi_number) {
+        // Compact peer handle, see peer-handles.h
+        double number = 0;
+        napi_status status = napi_get_value_double(env, value, &number);
+        KOALA_NAPI_THROW_IF_FAILED(env, status, nullptr);
+        if (!(number >= 0 && number <= INT32_MAX) || number != std::floor(number)) {
+            napi_throw_error(env, nullptr, "cannot be coerced to pointer, not a peer handle");
+            return nullptr;
+        }
+        auto handle = static_cast<int32_t>(number);
+        if (handle == 0) {
+            return nullptr;
+        }
+        KNativePointer result = PeerHandles::Instance()->Resolve(handle);
+        if (result == nullptr) {
+            napi_throw_error(env, nullptr, "cannot be coerced to pointer, unknown or released peer handle");
+        }
+        return result;
+    }
+
     if (valueType != napi_valuetype::napi_bigint) {
         napi_throw_error(env, nullptr, "cannot be coerced to pointer");
         return nullptr;
@@ -195,18 +267,12 @@ KULong getUInt64(napi_env env, napi_value value)
 
 napi_value makeString(napi_env env, const KStringPtr& value)
 {
-    napi_value result;
-    napi_status status = napi_create_string_utf8(env, value.isNull() ? "" : value.data(), value.length(), &result);
-    KOALA_NAPI_THROW_IF_FAILED(env, status, result);
-    return result;
+    return createString(env, value.isNull() ? "" : value.data(), value.length());
 }
 
 napi_value makeString(napi_env env, const std::string& value)
 {
-    napi_value result;
-    napi_status status = napi_create_string_utf8(env, value.c_str(), value.length(), &result);
-    KOALA_NAPI_THROW_IF_FAILED(env, status, result);
-    return result;
+    return createString(env, value.c_str(), value.length());
 }
 
 napi_value makeBoolean(napi_env env, int8_t value)
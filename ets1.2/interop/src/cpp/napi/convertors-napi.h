@@ -18,6 +18,7 @@
 
 #ifdef KOALA_NAPI
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -66,6 +67,10 @@ inline void releaseArgument(napi_env env, typename InteropTypeConverter<Type>::I
 }
 
 napi_value makeString(napi_env env, KStringPtr value);
+// Copies the string value into result with a single conversion, see convertors-napi.cpp
+napi_status readString(napi_env env, napi_value value, KStringPtr& result);
+// Creates a JS string from UTF-8, ASCII data takes the cheaper latin1 path
+napi_value createString(napi_env env, const char* data, size_t length);
 napi_value makeString(napi_env env, const std::string& value);
 napi_value makeBoolean(napi_env env, KBoolean value);
 napi_value makeInt32(napi_env env, int32_t value);
@@ -136,22 +141,14 @@ struct InteropTypeConverter<KStringPtr> {
     using InteropType = napi_value;
     static KStringPtr convertFrom(napi_env env, InteropType value)
     {
-        if (value == nullptr)
-            return KStringPtr();
         KStringPtr result;
-        size_t length = 0;
-        napi_status status = napi_get_value_string_utf8(env, value, nullptr, 0, &length);
-        if (status != 0)
-            return result;
-        result.resize(length);
-        status = napi_get_value_string_utf8(env, value, result.data(), length + 1, nullptr);
+        if (value != nullptr)
+            readString(env, value, result);
         return result;
     }
     static InteropType convertTo(napi_env env, const KStringPtr& value)
     {
-        napi_value result;
-        napi_create_string_utf8(env, value.c_str(), value.length(), &result);
-        return result;
+        return createString(env, value.c_str(), value.length());
     }
     static void release(napi_env env, InteropType value, const KStringPtr& converted) {}
 };
@@ -265,16 +262,6 @@ struct InteropTypeConverter<KStringArray> {
     using InteropType = napi_value;
     using SelfType = InteropTypeConverter<KStringArray>;
     static constexpr auto LengthByteSize = sizeof(KUInt);
-    static char* strndup(const void* str, size_t n)
-    {
-        char* mem = static_cast<char*>(malloc(n + 1));
-        if (mem == nullptr) {
-            INTEROP_FATAL("malloc failed!")
-        }
-        interop_memory_copy(mem, n + 1, str, n);
-        mem[n] = 0;
-        return mem;
-    }
     static size_t decodeLength(const uint8_t* data)
     {
         if (data == nullptr) {
@@ -282,15 +269,26 @@ struct InteropTypeConverter<KStringArray> {
         }
         return (data[NUM_3] << NUM_24) | (data[NUM_2] << NUM_16) | (data[NUM_1] << NUM_8) | data[0];
     }
+    // Decodes [count, (length, bytes)...] into a single block: the null terminated
+    // pointer table followed by the NUL terminated payloads.
     static KStringArray convertFrom(napi_env env, InteropType value)
     {
         size_t bytes = 0;
         auto const encoded = getTypedElements<uint8_t>(env, value, bytes);
-        if (!bytes)
+        if (bytes < LengthByteSize)
             return { { nullptr, nullptr }, 0 };
 
         size_t const num = decodeLength(encoded);
-        size_t bufferSize = sizeof(char*) * (num + 1);
+        size_t count = 0;
+        size_t payloadSize = 0;
+        for (size_t offset = LengthByteSize; count < num && offset + LengthByteSize <= bytes; count++) {
+            size_t length = std::min(decodeLength(encoded + offset), bytes - offset - LengthByteSize);
+            payloadSize += length + 1;
+            offset += LengthByteSize + length;
+        }
+
+        size_t tableSize = sizeof(char*) * (count + 1);
+        size_t bufferSize = tableSize + payloadSize;
         char** mem = static_cast<char**>(malloc(bufferSize));
         if (mem == nullptr) {
             INTEROP_FATAL("malloc failed, size = %zu", bufferSize);
@@ -298,14 +296,19 @@ struct InteropTypeConverter<KStringArray> {
         }
         KStringArray::Holder result(mem, &free);
 
-        size_t count = 0;
-        auto const* ptr = encoded + LengthByteSize;
-        auto const* const end = encoded + bytes;
-        while (ptr < end && count < num) {
-            auto length = decodeLength(ptr);
-            result[count++] = SelfType::strndup(ptr + LengthByteSize, length);
-            ptr += LengthByteSize + length;
+        char* payload = reinterpret_cast<char*>(mem) + tableSize;
+        size_t offset = LengthByteSize;
+        for (size_t i = 0; i < count; i++) {
+            size_t length = std::min(decodeLength(encoded + offset), bytes - offset - LengthByteSize);
+            if (length > 0) {
+                interop_memory_copy(payload, length, encoded + offset + LengthByteSize, length);
+            }
+            payload[length] = 0;
+            result[i] = payload;
+            payload += length + 1;
+            offset += LengthByteSize + length;
         }
+        result[count] = nullptr;
         return { std::move(result), count };
     }
     static InteropType convertTo(napi_env env, KStringArray value) = delete;
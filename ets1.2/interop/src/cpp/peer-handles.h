@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _INTEROP_PEER_HANDLES_H_
+#define _INTEROP_PEER_HANDLES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "interop-types.h"
+
+/*
+ * Maps native peers to positive 31-bit handles, so that bridges can hand peers
+ * to the managed side as plain numbers instead of BigInts. Handles belong to a
+ * scope (usually the compiler context) and are released together with it.
+ * Handle 0 is reserved for null. The low INDEX_BITS select a slot, the high bits
+ * carry the generation of the slot, bumped on every release, so a stale handle
+ * of a released scope does not resolve to the peer now reusing its slot until
+ * the slot has gone through 2^9 releases. The table is per thread, like the VM
+ * using it.
+ */
+class PeerHandles {
+public:
+    static constexpr int32_t INDEX_BITS = 22;
+    static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static constexpr uint32_t GENERATION_MASK = (1u << (31 - INDEX_BITS)) - 1;
+
+    static PeerHandles* Instance()
+    {
+        static thread_local PeerHandles instance;
+        return &instance;
+    }
+
+    /*
+     * Returns the handle of the peer within the scope, allocating it on first use.
+     * Gives 0 once all 2^22 slots are live, callers then keep using the peer itself.
+     */
+    int32_t Acquire(void* scope, void* peer)
+    {
+        if (peer == nullptr) {
+            return 0;
+        }
+        // Bridges acquire many peers of one scope in a row
+        if (scope != lastScope || lastOwned == nullptr) {
+            lastOwned = &scopes[scope];
+            lastScope = scope;
+        }
+        auto [it, inserted] = lastOwned->try_emplace(peer, 0);
+        if (!inserted) {
+            return it->second;
+        }
+        uint32_t index = 0;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        } else if (slots.size() < INDEX_MASK) {
+            // Slot 0 would make the first handle 0, which means null
+            slots.push_back({ nullptr, 0 });
+            index = static_cast<uint32_t>(slots.size());
+        } else {
+            lastOwned->erase(it);
+            return 0;
+        }
+        Slot& slot = slots[index - 1];
+        slot.peer = peer;
+        it->second = static_cast<int32_t>((slot.generation << INDEX_BITS) | index);
+        return it->second;
+    }
+
+    // Null for handle 0 and for handles which are unknown or were released.
+    void* Resolve(int32_t handle) const
+    {
+        if (handle <= 0) {
+            return nullptr;
+        }
+        auto bits = static_cast<uint32_t>(handle);
+        uint32_t index = bits & INDEX_MASK;
+        if (index == 0 || index > slots.size()) {
+            return nullptr;
+        }
+        const Slot& slot = slots[index - 1];
+        return slot.generation == (bits >> INDEX_BITS) ? slot.peer : nullptr;
+    }
+
+    // Frees all handles of the scope at once, their slots are reused under the next generation.
+    void Release(void* scope)
+    {
+        auto it = scopes.find(scope);
+        if (it == scopes.end()) {
+            return;
+        }
+        freeSlots.reserve(freeSlots.size() + it->second.size());
+        for (auto& [peer, handle] : it->second) {
+            uint32_t index = static_cast<uint32_t>(handle) & INDEX_MASK;
+            Slot& slot = slots[index - 1];
+            slot.peer = nullptr;
+            slot.generation = (slot.generation + 1) & GENERATION_MASK;
+            freeSlots.push_back(index);
+        }
+        scopes.erase(it);
+        if (scope == lastScope) {
+            lastScope = nullptr;
+            lastOwned = nullptr;
+        }
+    }
+
+    size_t Size() const
+    {
+        return slots.size() - freeSlots.size();
+    }
+
+private:
+    struct Slot {
+        void* peer;
+        uint32_t generation;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::unordered_map<void*, std::unordered_map<void*, int32_t>> scopes;
+    void* lastScope = nullptr;
+    std::unordered_map<void*, int32_t>* lastOwned = nullptr;
+};
+
+#endif // _INTEROP_PEER_HANDLES_H_
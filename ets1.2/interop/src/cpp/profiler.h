@@ -17,91 +17,342 @@
 #define _KOALA_PROFILER_
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <cstdio>
+#include <mutex>
 #include <stdint.h>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "interop-utils.h"
 
+/*
+ * Latency histogram of one bridge: exact below 32ns, then eight sub-buckets per
+ * power of two (12.5% precision) up to 2^40ns.
+ */
+struct InteropProfilerHistogram {
+    static constexpr int LINEAR_BITS = 5;
+    static constexpr int SUB_BITS = 3;
+    static constexpr int MAX_BITS = 40;
+    static constexpr int LINEAR_BUCKETS = 1 << LINEAR_BITS;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int BUCKETS = LINEAR_BUCKETS + (MAX_BITS - LINEAR_BITS + 1) * SUB_BUCKETS;
+
+    static int bucketOf(uint64_t ns)
+    {
+        if (ns < static_cast<uint64_t>(LINEAR_BUCKETS)) {
+            return static_cast<int>(ns);
+        }
+        ns = std::min<uint64_t>(ns, (uint64_t(1) << (MAX_BITS + 1)) - 1);
+        int msb = 63 - __builtin_clzll(ns);
+        int sub = static_cast<int>((ns >> (msb - SUB_BITS)) & (SUB_BUCKETS - 1));
+        return LINEAR_BUCKETS + (msb - LINEAR_BITS) * SUB_BUCKETS + sub;
+    }
+
+    // Smallest value falling into the bucket
+    static uint64_t lowerBound(int bucket)
+    {
+        if (bucket < LINEAR_BUCKETS) {
+            return static_cast<uint64_t>(bucket);
+        }
+        int msb = LINEAR_BITS + (bucket - LINEAR_BUCKETS) / SUB_BUCKETS;
+        uint64_t sub = static_cast<uint64_t>((bucket - LINEAR_BUCKETS) % SUB_BUCKETS);
+        return (uint64_t(SUB_BUCKETS) + sub) << (msb - SUB_BITS);
+    }
+};
+
+// Counters of one bridge on one thread. Only the owning thread writes them.
+struct InteropProfilerSlot {
+    std::atomic<uint64_t> count { 0 };
+    std::atomic<uint64_t> time { 0 };
+    std::atomic<uint64_t> max { 0 };
+    std::atomic<uint32_t> buckets[InteropProfilerHistogram::BUCKETS] {};
+
+    void record(uint64_t ns)
+    {
+        // Single writer, plain load and store are enough and avoid locked instructions
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        time.store(time.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > max.load(std::memory_order_relaxed)) {
+            max.store(ns, std::memory_order_relaxed);
+        }
+        auto& bucket = buckets[InteropProfilerHistogram::bucketOf(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        count.store(0, std::memory_order_relaxed);
+        time.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+        for (auto& bucket : buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+// Merged view of a bridge over all threads
 struct InteropProfilerRecord {
-    int64_t time;
-    int64_t count;
-    InteropProfilerRecord(int64_t time, int64_t count) : time(time), count(count) {}
+    const char* name;
+    uint64_t count;
+    uint64_t time;
+    uint64_t max;
+    uint64_t p50;
+    uint64_t p99;
+};
+
+enum InteropProfilerFormat {
+    INTEROP_PROFILER_TEXT = 0,
+    INTEROP_PROFILER_TRACE_JSON = 1,
+    INTEROP_PROFILER_BINARY = 2,
 };
 
+/*
+ * Every exported bridge registers a slot once (see KOALA_INTEROP_LOGGER), calls then
+ * record into per-thread tables by slot index, without allocations, hashing or locks.
+ * Thread tables are kept after their thread exits and merged when reporting.
+ */
 class InteropProfiler {
+public:
+    static constexpr int32_t MAX_SLOTS = 8192;
+
+    static InteropProfiler* instance()
+    {
+        static InteropProfiler profiler;
+        return &profiler;
+    }
+
+    int32_t registerSlot(const char* name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (names.size() >= static_cast<size_t>(MAX_SLOTS)) {
+            return -1;
+        }
+        names.push_back(name);
+        return static_cast<int32_t>(names.size() - 1);
+    }
+
+    bool isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool value)
+    {
+        enabled.store(value, std::memory_order_relaxed);
+    }
+
+    void record(int32_t slot, int64_t ns)
+    {
+        if (slot < 0) {
+            return;
+        }
+        ThreadTable* table = currentTable();
+        InteropProfilerSlot* stats = table->slots[slot].load(std::memory_order_acquire);
+        if (stats == nullptr) {
+            stats = new InteropProfilerSlot();
+            table->slots[slot].store(stats, std::memory_order_release);
+        }
+        stats->record(static_cast<uint64_t>(std::max<int64_t>(ns, 0)));
+    }
+
+    // Sorted by total time, bridges without calls are skipped
+    std::vector<InteropProfilerRecord> collect()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<InteropProfilerRecord> result;
+        std::vector<uint64_t> buckets(InteropProfilerHistogram::BUCKETS);
+        for (size_t slot = 0; slot < names.size(); slot++) {
+            InteropProfilerRecord record { names[slot], 0, 0, 0, 0, 0 };
+            std::fill(buckets.begin(), buckets.end(), 0);
+            for (auto* table : tables) {
+                auto* stats = table->slots[slot].load(std::memory_order_acquire);
+                if (stats == nullptr) {
+                    continue;
+                }
+                record.count += stats->count.load(std::memory_order_relaxed);
+                record.time += stats->time.load(std::memory_order_relaxed);
+                record.max = std::max(record.max, stats->max.load(std::memory_order_relaxed));
+                for (int i = 0; i < InteropProfilerHistogram::BUCKETS; i++) {
+                    buckets[i] += stats->buckets[i].load(std::memory_order_relaxed);
+                }
+            }
+            if (record.count == 0) {
+                continue;
+            }
+            const double P50 = 0.5;
+            const double P99 = 0.99;
+            record.p50 = percentile(buckets, P50, record.max);
+            record.p99 = percentile(buckets, P99, record.max);
+            result.push_back(record);
+        }
+        std::sort(result.begin(), result.end(),
+            [](const InteropProfilerRecord& a, const InteropProfilerRecord& b) { return b.time < a.time; });
+        return result;
+    }
+
+    std::string report(InteropProfilerFormat format = INTEROP_PROFILER_TEXT)
+    {
+        auto records = collect();
+        switch (format) {
+            case INTEROP_PROFILER_TRACE_JSON:
+                return reportTraceJson(records);
+            case INTEROP_PROFILER_BINARY:
+                return reportBinary(records);
+            default:
+                return reportText(records);
+        }
+    }
+
+    // Counters being written concurrently by other threads may survive the reset
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto* table : tables) {
+            for (auto& slot : table->slots) {
+                auto* stats = slot.load(std::memory_order_acquire);
+                if (stats != nullptr) {
+                    stats->reset();
+                }
+            }
+        }
+    }
+
 private:
-    std::unordered_map<std::string, InteropProfilerRecord> records;
-    static InteropProfiler* _instance;
+    struct ThreadTable {
+        std::atomic<InteropProfilerSlot*> slots[MAX_SLOTS] {};
+    };
+
+    std::mutex mutex;
+    std::vector<const char*> names;
+    std::vector<ThreadTable*> tables;
+    std::atomic<bool> enabled { true };
+
     InteropProfiler() {}
 
-public:
-    static InteropProfiler* instance()
+    ThreadTable* currentTable()
     {
-        if (!_instance)
-            _instance = new InteropProfiler();
-        return _instance;
+        static thread_local ThreadTable* table = nullptr;
+        if (table == nullptr) {
+            table = new ThreadTable();
+            std::lock_guard<std::mutex> lock(mutex);
+            tables.push_back(table);
+        }
+        return table;
     }
 
-    void record(const char* name, int64_t ns)
+    static uint64_t percentile(const std::vector<uint64_t>& buckets, double fraction, uint64_t max)
     {
-        auto it = records.find(name);
-        if (it == records.end()) {
-            records.insert({ name, InteropProfilerRecord(ns, 1) });
-        } else {
-            it->second.time += ns;
-            it->second.count++;
+        uint64_t total = 0;
+        for (auto count : buckets) {
+            total += count;
+        }
+        // Smallest bucket covering at least the fraction of all calls
+        auto rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(total))), 1);
+        uint64_t seen = 0;
+        for (int i = 0; i < InteropProfilerHistogram::BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                // Upper end of the bucket, but never above the observed maximum
+                uint64_t upper = i + 1 < InteropProfilerHistogram::BUCKETS
+                    ? InteropProfilerHistogram::lowerBound(i + 1) - 1 : max;
+                return std::min(upper, max);
+            }
         }
+        return max;
     }
 
-    std::string report()
+    static std::string reportText(const std::vector<InteropProfilerRecord>& records)
     {
-        std::vector<std::pair<std::string, InteropProfilerRecord>> elems(records.begin(), records.end());
-        std::sort(elems.begin(), elems.end(),
-            [](const std::pair<std::string, InteropProfilerRecord>& a,
-                const std::pair<std::string, InteropProfilerRecord>& b) { return b.second.time < a.second.time; });
-        int64_t total = 0;
-        std::for_each(elems.begin(), elems.end(),
-            [&total](const std::pair<std::string, InteropProfilerRecord>& a) { total += a.second.time; });
+        uint64_t total = 0;
+        for (auto& record : records) {
+            total += record.time;
+        }
         std::string result;
-        std::for_each(
-            elems.begin(), elems.end(), [total, &result](const std::pair<std::string, InteropProfilerRecord>& a) {
-                auto ns = a.second.time;
-                auto count = a.second.count;
-                char buffer[1024];
-                const double MAX = 100.0;
-                InteropPrintToBufferN(buffer, sizeof buffer, "for %s[%lld]: %.01f%% (%lld)\n", a.first.c_str(),
-                    (long long)count, (double)ns / total * MAX, (long long)ns);
-                result += buffer;
-            });
+        for (auto& record : records) {
+            char buffer[1024];
+            const double MAX = 100.0;
+            InteropPrintToBufferN(buffer, sizeof buffer, "for %s[%llu]: %.01f%% (%llu) p50 %llu p99 %llu max %llu\n",
+                record.name, (unsigned long long)record.count, (double)record.time / total * MAX,
+                (unsigned long long)record.time, (unsigned long long)record.p50, (unsigned long long)record.p99,
+                (unsigned long long)record.max);
+            result += buffer;
+        }
         return result;
     }
 
-    void reset()
+    /*
+     * Chrome trace-event format (chrome://tracing, Perfetto). The profiler only keeps
+     * aggregates, so this is not a timeline: each bridge is one counter event at ts 0
+     * holding its statistics, after a metadata event naming the process. For real per
+     * call timing record a trace with the tracer (tracer.h) instead.
+     */
+    static std::string reportTraceJson(const std::vector<InteropProfilerRecord>& records)
     {
-        records.clear();
+        std::string result = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":["
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"interop profiler\"}}";
+        for (auto& record : records) {
+            char buffer[1024];
+            InteropPrintToBufferN(buffer, sizeof buffer,
+                ",{\"name\":\"%s\",\"cat\":\"interop\",\"ph\":\"C\",\"pid\":0,\"ts\":0,"
+                "\"args\":{\"count\":%llu,\"time_ns\":%llu,\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}}",
+                record.name, (unsigned long long)record.count, (unsigned long long)record.time,
+                (unsigned long long)record.p50, (unsigned long long)record.p99, (unsigned long long)record.max);
+            result += buffer;
+        }
+        result += "]}";
+        return result;
+    }
+
+    /*
+     * "KIPF", u32 version, u32 record count, then per record: u16 name length, name,
+     * u64 count, total, max, p50 and p99 in nanoseconds. Host byte order.
+     */
+    static std::string reportBinary(const std::vector<InteropProfilerRecord>& records)
+    {
+        const uint32_t VERSION = 1;
+        std::string result = "KIPF";
+        auto append = [&result](const void* data, size_t size) {
+            result.append(static_cast<const char*>(data), size);
+        };
+        auto count = static_cast<uint32_t>(records.size());
+        append(&VERSION, sizeof(VERSION));
+        append(&count, sizeof(count));
+        for (auto& record : records) {
+            auto length = static_cast<uint16_t>(std::min<size_t>(strlen(record.name), UINT16_MAX));
+            append(&length, sizeof(length));
+            append(record.name, length);
+            for (uint64_t value : { record.count, record.time, record.max, record.p50, record.p99 }) {
+                append(&value, sizeof(value));
+            }
+        }
+        return result;
     }
 };
 
 class InteropMethodCall {
 private:
-    const char* name;
+    int32_t slot;
     std::chrono::steady_clock::time_point begin;
 
 public:
-    InteropMethodCall(const char* name) : name(name)
+    InteropMethodCall(int32_t slot) : slot(InteropProfiler::instance()->isEnabled() ? slot : -1)
     {
-        begin = std::chrono::steady_clock::now();
+        if (this->slot >= 0) {
+            begin = std::chrono::steady_clock::now();
+        }
     }
     ~InteropMethodCall()
     {
+        if (slot < 0) {
+            return;
+        }
         auto end = std::chrono::steady_clock::now();
         int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
-        InteropProfiler::instance()->record(name, ns);
+        InteropProfiler::instance()->record(slot, ns);
     }
 };
 
-#endif // _KOALA_PROFILER_
\ No newline at end of file
+#endif // _KOALA_PROFILER_
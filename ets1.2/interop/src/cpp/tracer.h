@@ -16,33 +16,415 @@
 #ifndef _KOALA_TRACER_
 #define _KOALA_TRACER_
 
-#ifdef KOALA_OHOS
-#include <hilog/log.h>
-#define KOALA_TRACE(msg, str) OH_LOG_Print(LOG_APP, LOG_INFO, 0xFF00, "Koala", msg, str)
-// Also do
-//  hdc shell hilog -p off
-//  hdc shell hilog -Q pidoff
-// to see the output.
-#define KOALA_TRACE_PUBLIC "%{public}s"
-#else
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
-#define KOALA_TRACE(msg, str) fprintf(stderr, "Koala: " msg "\n", str)
-#define KOALA_TRACE_PUBLIC "%s"
-#endif
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Binary call tracer. Every traced call is one fixed-size record in a per-thread
+ * single-producer ring buffer, a background thread drains the rings into a file.
+ * interop/tools/trace-decode.mjs turns the file into a Chrome trace-event timeline.
+ *
+ * File layout, host byte order: "KITR", u32 version, u64 wall clock of the start in
+ * ns, then blocks of u32 type, u32 payload size and the payload:
+ *   BRIDGE:  u32 id, u16 module length, module, u16 name length, name
+ *   RECORDS: u32 thread, u32 reserved, InteropTraceRecord[]
+ *   DROPPED: u32 thread, u32 reserved, u64 records dropped so far in this trace
+ */
+struct InteropTraceRecord {
+    uint32_t bridge;
+    uint32_t depth;
+    uint64_t begin; // ns since the start of the trace
+    uint64_t duration;
+    uint64_t digest;
+};
+
+enum InteropTraceBlock : uint32_t {
+    INTEROP_TRACE_BRIDGE = 1,
+    INTEROP_TRACE_RECORDS = 2,
+    INTEROP_TRACE_DROPPED = 3,
+};
+
+class InteropTraceRing {
+public:
+    static constexpr uint64_t CAPACITY = 1 << 16;
+
+    explicit InteropTraceRing(uint32_t thread) : thread(thread) {}
+
+    // Producer side, called by the owning thread only. Drops the record when full.
+    void push(const InteropTraceRecord& record)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= CAPACITY) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        records[h & (CAPACITY - 1)] = record;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Consumer side, called by the flusher only
+    void drain(std::vector<InteropTraceRecord>& out)
+    {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        for (; t < h; t++) {
+            out.push_back(records[t & (CAPACITY - 1)]);
+        }
+        tail.store(t, std::memory_order_release);
+    }
+
+    // Consumer side, dropped records since the last restartDropped()
+    uint64_t droppedCount() const
+    {
+        return dropped.load(std::memory_order_relaxed) - droppedBefore;
+    }
+
+    // Consumer side, the producer owns the counter so the count of a new trace starts from a baseline
+    void restartDropped()
+    {
+        droppedBefore = dropped.load(std::memory_order_relaxed);
+    }
+
+    const uint32_t thread;
+
+private:
+    InteropTraceRecord records[CAPACITY];
+    std::atomic<uint64_t> head { 0 };
+    std::atomic<uint64_t> tail { 0 };
+    std::atomic<uint64_t> dropped { 0 };
+    uint64_t droppedBefore = 0;
+};
+
+/*
+ * Bridge ids carry their module index in the low bits, so the hot path checks the
+ * module mask without a table lookup. Tracing is started with start() or by setting
+ * KOALA_INTEROP_TRACE_FILE, optionally with KOALA_INTEROP_TRACE_SAMPLING (trace one
+ * call in N) and KOALA_INTEROP_TRACE_MODULES (comma separated module names).
+ */
+class InteropTracer {
+public:
+    static constexpr int32_t MODULE_BITS = 5;
+    static constexpr uint32_t MAX_MODULES = 1 << MODULE_BITS;
+    static constexpr uint32_t VERSION = 1;
+
+    static InteropTracer* instance()
+    {
+        static InteropTracer tracer;
+        return &tracer;
+    }
+
+    int32_t registerBridge(const char* module, const char* name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t moduleIndex = 0;
+        while (moduleIndex < modules.size() && modules[moduleIndex] != module) {
+            moduleIndex++;
+        }
+        if (moduleIndex == modules.size()) {
+            if (modules.size() == MAX_MODULES) {
+                moduleIndex = MAX_MODULES - 1;
+            } else {
+                modules.push_back(module);
+                updateMask();
+            }
+        }
+        int32_t id = static_cast<int32_t>((bridges.size() << MODULE_BITS) | moduleIndex);
+        bridges.push_back({ id, module, name });
+        return id;
+    }
+
+    // Empty module list traces all modules, sampling 1 traces every call
+    bool start(const char* path, uint32_t sampling, const char* moduleList)
+    {
+        stop();
+        std::lock_guard<std::mutex> lock(mutex);
+        file = fopen(path, "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        originTicks.store(steadyTicks(), std::memory_order_relaxed);
+        // Calls begun before this point measured against the old origin, see InteropMethodCall
+        session.fetch_add(1, std::memory_order_release);
+        uint64_t wallClock = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        fwrite("KITR", 1, 4, file);
+        fwrite(&VERSION, sizeof(VERSION), 1, file);
+        fwrite(&wallClock, sizeof(wallClock), 1, file);
+        writtenBridges = 0;
+        for (auto* ring : rings) {
+            // Calls that ended after the previous stop() belong to no trace
+            scratch.clear();
+            ring->drain(scratch);
+            ring->restartDropped();
+        }
+        enabledModules.clear();
+        for (const char* it = moduleList ? moduleList : ""; *it;) {
+            const char* end = strchr(it, ',');
+            size_t length = end ? static_cast<size_t>(end - it) : strlen(it);
+            if (length > 0) {
+                enabledModules.emplace_back(it, length);
+            }
+            it += length + (end ? 1 : 0);
+        }
+        updateMask();
+        samplingRate.store(sampling > 0 ? sampling : 1, std::memory_order_relaxed);
+        stopping = false;
+        flusher = std::thread([this]() { flushLoop(); });
+        active.store(true, std::memory_order_release);
+        return true;
+    }
+
+    void stop()
+    {
+        active.store(false, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        if (flusher.joinable()) {
+            flusher.join();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (file != nullptr) {
+            flush();
+            fclose(file);
+            file = nullptr;
+        }
+    }
+
+    bool shouldTrace(int32_t bridge)
+    {
+        if (!active.load(std::memory_order_acquire)) {
+            return false;
+        }
+        if ((moduleMask.load(std::memory_order_relaxed) & (1u << (bridge & (MAX_MODULES - 1)))) == 0) {
+            return false;
+        }
+        uint32_t rate = samplingRate.load(std::memory_order_relaxed);
+        if (rate <= 1) {
+            return true;
+        }
+        static thread_local uint32_t counter = 0;
+        if (++counter < rate) {
+            return false;
+        }
+        counter = 0;
+        return true;
+    }
+
+    // ns since the start of the trace
+    uint64_t now() const
+    {
+        return static_cast<uint64_t>(steadyTicks() - originTicks.load(std::memory_order_relaxed));
+    }
+
+    uint32_t currentSession() const
+    {
+        return session.load(std::memory_order_acquire);
+    }
+
+    void record(const InteropTraceRecord& record)
+    {
+        currentRing()->push(record);
+    }
+
+    // Digest of the innermost traced call of this thread, no-op outside of traced calls
+    static void digest(uint64_t value)
+    {
+        if (InteropTraceRecord* call = currentCall()) {
+            call->digest = value;
+        }
+    }
+
+    static InteropTraceRecord*& currentCall()
+    {
+        static thread_local InteropTraceRecord* call = nullptr;
+        return call;
+    }
+
+    static uint32_t& currentDepth()
+    {
+        static thread_local uint32_t depth = 0;
+        return depth;
+    }
+
+    ~InteropTracer()
+    {
+        stop();
+    }
+
+private:
+    struct Bridge {
+        int32_t id;
+        std::string module;
+        std::string name;
+    };
+
+    static constexpr auto FLUSH_PERIOD = std::chrono::milliseconds(50);
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::vector<std::string> modules;
+    std::vector<std::string> enabledModules;
+    std::vector<Bridge> bridges;
+    std::vector<InteropTraceRing*> rings;
+    std::vector<InteropTraceRecord> scratch;
+    std::atomic<bool> active { false };
+    std::atomic<uint32_t> moduleMask { 0 };
+    std::atomic<uint32_t> samplingRate { 1 };
+    std::atomic<int64_t> originTicks { 0 };
+    std::atomic<uint32_t> session { 0 };
+    std::thread flusher;
+    bool stopping = false;
+    FILE* file = nullptr;
+    size_t writtenBridges = 0;
+
+    static int64_t steadyTicks()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    InteropTracer()
+    {
+        const char* path = getenv("KOALA_INTEROP_TRACE_FILE");
+        if (path != nullptr && *path != 0) {
+            const char* sampling = getenv("KOALA_INTEROP_TRACE_SAMPLING");
+            start(path, sampling ? static_cast<uint32_t>(strtoul(sampling, nullptr, 10)) : 1,
+                getenv("KOALA_INTEROP_TRACE_MODULES"));
+        }
+    }
+
+    // Rings are kept after their thread exits, so that nothing is lost before the next flush
+    InteropTraceRing* currentRing()
+    {
+        static thread_local InteropTraceRing* ring = nullptr;
+        if (ring == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ring = new InteropTraceRing(static_cast<uint32_t>(rings.size()));
+            rings.push_back(ring);
+        }
+        return ring;
+    }
+
+    // Requires the mutex
+    void updateMask()
+    {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < modules.size(); i++) {
+            bool enabled = enabledModules.empty();
+            for (auto& it : enabledModules) {
+                enabled = enabled || it == modules[i];
+            }
+            mask |= enabled ? 1u << i : 0;
+        }
+        if (modules.size() == MAX_MODULES) {
+            // The last index is shared by all further modules
+            mask |= enabledModules.empty() ? 1u << (MAX_MODULES - 1) : 0;
+        }
+        moduleMask.store(mask, std::memory_order_relaxed);
+    }
+
+    void writeBlock(InteropTraceBlock type, const std::vector<std::pair<const void*, size_t>>& parts)
+    {
+        uint32_t size = 0;
+        for (auto& part : parts) {
+            size += static_cast<uint32_t>(part.second);
+        }
+        uint32_t header[] = { type, size };
+        fwrite(header, sizeof(header), 1, file);
+        for (auto& part : parts) {
+            fwrite(part.first, 1, part.second, file);
+        }
+    }
+
+    // Requires the mutex
+    void flush()
+    {
+        for (; writtenBridges < bridges.size(); writtenBridges++) {
+            auto& bridge = bridges[writtenBridges];
+            auto moduleLength = static_cast<uint16_t>(bridge.module.size());
+            auto nameLength = static_cast<uint16_t>(bridge.name.size());
+            writeBlock(INTEROP_TRACE_BRIDGE, { { &bridge.id, sizeof(bridge.id) },
+                { &moduleLength, sizeof(moduleLength) }, { bridge.module.data(), moduleLength },
+                { &nameLength, sizeof(nameLength) }, { bridge.name.data(), nameLength } });
+        }
+        const uint32_t reserved = 0;
+        for (auto* ring : rings) {
+            scratch.clear();
+            ring->drain(scratch);
+            if (!scratch.empty()) {
+                writeBlock(INTEROP_TRACE_RECORDS, { { &ring->thread, sizeof(ring->thread) },
+                    { &reserved, sizeof(reserved) },
+                    { scratch.data(), scratch.size() * sizeof(InteropTraceRecord) } });
+            }
+            uint64_t dropped = ring->droppedCount();
+            if (dropped > 0) {
+                writeBlock(INTEROP_TRACE_DROPPED, { { &ring->thread, sizeof(ring->thread) },
+                    { &reserved, sizeof(reserved) }, { &dropped, sizeof(dropped) } });
+            }
+        }
+        fflush(file);
+    }
+
+    void flushLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            wakeup.wait_for(lock, FLUSH_PERIOD);
+            if (file != nullptr) {
+                flush();
+            }
+        }
+    }
+};
 
 class InteropMethodCall {
 private:
-    const char* name;
+    int32_t bridge;
+    uint32_t session = 0;
+    InteropTraceRecord* outer = nullptr;
+    InteropTraceRecord record;
 
 public:
-    InteropMethodCall(const char* name) : name(name)
+    InteropMethodCall(int32_t bridge) : bridge(InteropTracer::instance()->shouldTrace(bridge) ? bridge : -1)
     {
-        KOALA_TRACE(">>> " KOALA_TRACE_PUBLIC, name);
+        if (this->bridge < 0) {
+            return;
+        }
+        auto* tracer = InteropTracer::instance();
+        auto& depth = InteropTracer::currentDepth();
+        session = tracer->currentSession();
+        record = { static_cast<uint32_t>(bridge), depth++, tracer->now(), 0, 0 };
+        outer = InteropTracer::currentCall();
+        InteropTracer::currentCall() = &record;
     }
     ~InteropMethodCall()
     {
-        KOALA_TRACE("<<< " KOALA_TRACE_PUBLIC, name);
+        if (bridge < 0) {
+            return;
+        }
+        auto* tracer = InteropTracer::instance();
+        uint64_t end = tracer->now();
+        InteropTracer::currentDepth()--;
+        InteropTracer::currentCall() = outer;
+        // A call begun before a restart has its begin relative to the previous trace
+        if (tracer->currentSession() != session || end < record.begin) {
+            return;
+        }
+        record.duration = end - record.begin;
+        tracer->record(record);
     }
 };
 
-#endif // _KOALA_TRACER_
\ No newline at end of file
+#endif // _KOALA_TRACER_
@@ -81,16 +81,21 @@ struct KStringPtrImpl {
 
     KStringPtrImpl(KStringPtrImpl&& other)
     {
-        this->_value = other.release();
         this->_owned = other._owned;
-        other._owned = false;
         this->_length = other._length;
+        if (other.isInline()) {
+            interop_memory_copy(_inline, sizeof(_inline), other._inline, other._length + 1);
+            this->_value = _inline;
+            other._value = nullptr;
+        } else {
+            this->_value = other.release();
+        }
+        other._owned = false;
     }
 
     ~KStringPtrImpl()
     {
-        if (_value && _owned)
-            free(_value);
+        dispose();
     }
 
     bool isNull() const
@@ -116,16 +121,8 @@ struct KStringPtrImpl {
         if (!_owned)
             return;
         // Ignore old content.
-        if (_value && _owned)
-            free(_value);
-        auto memSize { static_cast<std::size_t>(std::max(0, _length + 1)) };
-        if (memSize == 0) {
-            INTEROP_FATAL("Zero allocate size. Cannot allocate memory");
-        }
-        _value = reinterpret_cast<char*>(malloc(memSize));
-        if (!_value) {
-            INTEROP_FATAL("Cannot allocate memory");
-        }
+        dispose();
+        _value = allocate(_length);
         _value[_length] = 0;
     }
 
@@ -136,15 +133,10 @@ struct KStringPtrImpl {
 
     void assign(const char* data, int length)
     {
-        if (_value && _owned)
-            free(_value);
+        dispose();
         if (data) {
             if (_owned) {
-                auto memSize { static_cast<std::size_t>(std::max(0, length + 1)) };
-                _value = reinterpret_cast<char*>(malloc(memSize));
-                if (!_value) {
-                    INTEROP_FATAL("Cannot allocate memory");
-                }
+                _value = allocate(length);
                 interop_memory_copy(_value, length, data, length);
                 _value[length] = 0;
             } else {
@@ -165,29 +157,56 @@ protected:
     }
 
 private:
+    // Short owned strings (most identifiers) are kept inline to avoid a malloc
+    static constexpr int INLINE_CAPACITY = 32;
+
+    bool isInline() const
+    {
+        return _value == _inline;
+    }
+
+    char* allocate(int length)
+    {
+        if (length < INLINE_CAPACITY) {
+            return _inline;
+        }
+        auto memSize { static_cast<std::size_t>(std::max(0, length + 1)) };
+        auto* result = reinterpret_cast<char*>(malloc(memSize));
+        if (!result) {
+            INTEROP_FATAL("Cannot allocate memory");
+        }
+        return result;
+    }
+
+    void dispose()
+    {
+        if (_value && _owned && !isInline())
+            free(_value);
+        _value = nullptr;
+    }
+
     char* _value;
     int _length;
     bool _owned;
+    char _inline[INLINE_CAPACITY];
 };
 
 struct KStringArrayImpl {
-    // Null terminated, [char*, char*, ..., nullptr]
+    // Null terminated, [char*, char*, ..., nullptr], followed by the strings in the same block
     using Holder = std::unique_ptr<char*[], decltype(&free)>;
 
     KStringArrayImpl() : KStringArrayImpl({ nullptr, nullptr }, 0) {}
     KStringArrayImpl(Holder strs, size_t num) : _holder(std::move(strs)), _num(num) {}
     KStringArrayImpl(KStringArrayImpl& other) : _holder(std::move(other._holder)), _num(other._num) {}
 
-    ~KStringArrayImpl()
+    const char* const* get() const
     {
-        for (size_t k = 0; k < _num; k++) {
-            free(_holder[k]);
-        }
+        return _holder.get();
     }
 
-    const char* const* get() const
+    size_t size() const
     {
-        return _holder.get();
+        return _num;
     }
 
     char** release()
@@ -159,6 +159,27 @@ export class InteropNativeModule {
     public static _CopyArray(data: KPointer, length: int64, args: KUint8ArrayPtr): void {
         throw 'method not loaded';
     }
+    // Profiler methods are only present in natives built with KOALA_INTEROP_PROFILER
+    public static _ProfilerSetEnabled(enabled: boolean): void {
+        throw 'method not loaded';
+    }
+    public static _ProfilerReport(): string {
+        throw 'method not loaded';
+    }
+    /** @param format 0 for text, 1 for Chrome trace-event JSON counters (aggregates, not a timeline), 2 for binary */
+    public static _ProfilerDump(path: string, format: int32): boolean {
+        throw 'method not loaded';
+    }
+    public static _ProfilerReset(): void {
+        throw 'method not loaded';
+    }
+    // Tracer methods are only present in natives built with KOALA_INTEROP_TRACER
+    public static _TraceStart(path: string, sampling: int32, modules: string): boolean {
+        throw 'method not loaded';
+    }
+    public static _TraceStop(): void {
+        throw 'method not loaded';
+    }
 }
 
 export function loadInteropNativeModule(): void {
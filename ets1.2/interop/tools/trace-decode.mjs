@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Converts a trace written by interop/src/cpp/tracer.h into Chrome trace-event JSON,
+// to be opened in chrome://tracing or Perfetto.
+//   node trace-decode.mjs <trace file> [<output.json>]
+
+import * as fs from 'fs'
+
+const BLOCK_BRIDGE = 1
+const BLOCK_RECORDS = 2
+const BLOCK_DROPPED = 3
+const RECORD_SIZE = 32
+const FILE_HEADER_SIZE = 16
+const BLOCK_HEADER_SIZE = 8
+
+const [input, output = input + '.json'] = process.argv.slice(2)
+if (!input) {
+    console.error('usage: node trace-decode.mjs <trace file> [<output.json>]')
+    process.exit(1)
+}
+
+const fd = fs.openSync(input, 'r')
+const out = fs.openSync(output, 'w')
+
+function read(size) {
+    const buffer = Buffer.alloc(size)
+    const length = fs.readSync(fd, buffer, 0, size, null)
+    return length === size ? buffer : undefined
+}
+
+const header = read(FILE_HEADER_SIZE)
+if (!header || header.toString('latin1', 0, 4) !== 'KITR') {
+    console.error(`${input} is not an interop trace`)
+    process.exit(1)
+}
+const version = header.readUInt32LE(4)
+const startTime = header.readBigUInt64LE(8)
+
+const bridges = new Map()
+const dropped = new Map()
+let events = 0
+let pending = []
+
+function emit(event) {
+    pending.push((events++ === 0 ? '' : ',\n') + JSON.stringify(event))
+    if (pending.length >= 4096) {
+        fs.writeSync(out, pending.join(''))
+        pending = []
+    }
+}
+
+fs.writeSync(out, '{"displayTimeUnit":"ns","traceEvents":[\n')
+for (let block = read(BLOCK_HEADER_SIZE); block; block = read(BLOCK_HEADER_SIZE)) {
+    const type = block.readUInt32LE(0)
+    const payload = read(block.readUInt32LE(4))
+    if (!payload) {
+        console.warn('truncated trace, the last block is skipped')
+        break
+    }
+    if (type === BLOCK_BRIDGE) {
+        const id = payload.readUInt32LE(0)
+        const moduleLength = payload.readUInt16LE(4)
+        const module = payload.toString('utf8', 6, 6 + moduleLength)
+        const nameLength = payload.readUInt16LE(6 + moduleLength)
+        const name = payload.toString('utf8', 8 + moduleLength, 8 + moduleLength + nameLength)
+        bridges.set(id, { module, name })
+    } else if (type === BLOCK_RECORDS) {
+        const thread = payload.readUInt32LE(0)
+        for (let offset = 8; offset + RECORD_SIZE <= payload.length; offset += RECORD_SIZE) {
+            const id = payload.readUInt32LE(offset)
+            const bridge = bridges.get(id) ?? { module: 'unknown', name: `bridge#${id}` }
+            const digest = payload.readBigUInt64LE(offset + 24)
+            emit({
+                name: bridge.name,
+                cat: bridge.module,
+                ph: 'X',
+                pid: 0,
+                tid: thread,
+                ts: Number(payload.readBigUInt64LE(offset + 8)) / 1000,
+                dur: Number(payload.readBigUInt64LE(offset + 16)) / 1000,
+                args: digest ? { depth: payload.readUInt32LE(offset + 4), digest: digest.toString(16) }
+                             : { depth: payload.readUInt32LE(offset + 4) },
+            })
+        }
+    } else if (type === BLOCK_DROPPED) {
+        dropped.set(payload.readUInt32LE(0), payload.readBigUInt64LE(8))
+    }
+}
+fs.writeSync(out, pending.join(''))
+fs.writeSync(out, `\n],"otherData":${JSON.stringify({
+    version,
+    startTime: startTime.toString(),
+    dropped: Object.fromEntries([...dropped].map(([thread, count]) => [thread, count.toString()])),
+})}}\n`)
+fs.closeSync(out)
+fs.closeSync(fd)
+
+const lost = [...dropped.values()].reduce((sum, count) => sum + count, 0n)
+console.log(`${events} calls written to ${output}` + (lost ? `, ${lost} dropped on full buffers` : ''))
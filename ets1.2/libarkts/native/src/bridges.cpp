@@ -13,8 +13,9 @@
  * limitations under the License.
  */
 
+#include <atomic>
+#include <memory>
 #include <mutex>
-#include <set>
 #include <string>
 
 #include "common.h"
@@ -92,30 +93,188 @@ KOALA_INTEROP_2(OptionsArkTsConfig, KNativePointer, KNativePointer, KNativePoint
 // From koala-wrapper
 // Improve: check if some code should be generated
 
-std::set<std::string> globalStructInfo;
+/*
+ * Struct names registered by the UI plugin, shared by all contexts. Shards are
+ * picked by the name hash, each one an open addressing table of (hash, name)
+ * published through an atomic pointer. Lookups neither lock nor allocate, so
+ * they are wait-free; inserts lock only their shard and grow it by publishing a
+ * bigger copy. Replaced tables and names are kept until exit, since concurrent
+ * readers may still probe them. Null names are treated as empty ones.
+ */
+class StructRegistry {
+public:
+    StructRegistry() = default;
+    StructRegistry(const StructRegistry&) = delete;
+    StructRegistry& operator=(const StructRegistry&) = delete;
+
+    ~StructRegistry()
+    {
+        for (auto& shard : shards) {
+            const Table* table = shard.table.load(std::memory_order_relaxed);
+            for (size_t i = 0; table != nullptr && i < table->capacity; i++) {
+                free(const_cast<char*>(table->slots[i].name.load(std::memory_order_relaxed)));
+            }
+        }
+    }
+
+    bool Contains(const char* name, size_t length) const
+    {
+        uint64_t hash = SlotHash(name, length);
+        const Table* table = shards[ShardOf(hash)].table.load(std::memory_order_acquire);
+        return table != nullptr && Probe(*table, name, length, hash) != nullptr;
+    }
+
+    void Insert(const char* name, size_t length)
+    {
+        uint64_t hash = SlotHash(name, length);
+        Shard& shard = shards[ShardOf(hash)];
 #ifdef _GLIBCXX_HAS_GTHREADS
-std::mutex g_structMutex;
+        std::lock_guard<std::mutex> lock(shard.mutex);
 #endif
+        Table* table = shard.table.load(std::memory_order_relaxed);
+        if (table != nullptr && Probe(*table, name, length, hash) != nullptr) {
+            return;
+        }
+        // Keep load factor below 1/2, so probes always end at an empty slot
+        if (table == nullptr || (shard.count + 1) * 2 > table->capacity) {
+            table = Grow(shard);
+        }
+        auto* stored = static_cast<char*>(malloc(length + 1));
+        if (stored == nullptr) {
+            INTEROP_FATAL("Cannot allocate memory");
+        }
+        interop_memory_copy(stored, length + 1, name, length);
+        stored[length] = '\0';
+        Place(*table, stored, hash);
+        shard.count++;
+    }
 
-void impl_InsertGlobalStructInfo(KNativePointer contextPtr, KStringPtr& instancePtr)
-{
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+    static constexpr size_t INITIAL_CAPACITY = 64;
+
+    struct Slot {
+        // Zero marks an empty slot, the name is published before the hash
+        std::atomic<uint64_t> hash { 0 };
+        std::atomic<const char*> name { nullptr };
+    };
+
+    struct Table {
+        explicit Table(size_t capacity) : capacity(capacity), slots(new Slot[capacity]) {}
+        size_t capacity;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    struct Shard {
+        std::atomic<Table*> table { nullptr };
+        std::vector<std::unique_ptr<Table>> tables; // current and replaced ones
+        size_t count = 0;
 #ifdef _GLIBCXX_HAS_GTHREADS
-    std::lock_guard<std::mutex> lock(g_structMutex);
+        std::mutex mutex;
 #endif
-    globalStructInfo.insert(getStringCopy(instancePtr));
-    return;
+    };
+
+    static uint64_t SlotHash(const char*& name, size_t& length)
+    {
+        if (name == nullptr) {
+            name = "";
+            length = 0;
+        }
+        uint64_t hash = HashString(name, length);
+        return hash != 0 ? hash : 1;
+    }
+
+    static size_t ShardOf(uint64_t hash)
+    {
+        return static_cast<size_t>(hash >> 60) % SHARD_COUNT;
+    }
+
+    static const char* Probe(const Table& table, const char* name, size_t length, uint64_t hash)
+    {
+        size_t mask = table.capacity - 1;
+        for (size_t index = hash & mask;; index = (index + 1) & mask) {
+            const Slot& slot = table.slots[index];
+            uint64_t slotHash = slot.hash.load(std::memory_order_acquire);
+            if (slotHash == 0) {
+                return nullptr;
+            }
+            const char* stored = slot.name.load(std::memory_order_relaxed);
+            if (slotHash == hash && strncmp(stored, name, length) == 0 && stored[length] == '\0') {
+                return stored;
+            }
+        }
+    }
+
+    static void Place(Table& table, const char* name, uint64_t hash)
+    {
+        size_t mask = table.capacity - 1;
+        size_t index = hash & mask;
+        while (table.slots[index].hash.load(std::memory_order_relaxed) != 0) {
+            index = (index + 1) & mask;
+        }
+        table.slots[index].name.store(name, std::memory_order_relaxed);
+        table.slots[index].hash.store(hash, std::memory_order_release);
+    }
+
+    static Table* Grow(Shard& shard)
+    {
+        const Table* old = shard.table.load(std::memory_order_relaxed);
+        auto table = std::make_unique<Table>(old ? old->capacity * 2 : INITIAL_CAPACITY);
+        for (size_t i = 0; old != nullptr && i < old->capacity; i++) {
+            uint64_t hash = old->slots[i].hash.load(std::memory_order_relaxed);
+            if (hash != 0) {
+                Place(*table, old->slots[i].name.load(std::memory_order_relaxed), hash);
+            }
+        }
+        Table* result = table.get();
+        shard.tables.push_back(std::move(table));
+        shard.table.store(result, std::memory_order_release);
+        return result;
+    }
+
+    Shard shards[SHARD_COUNT];
+};
+
+static StructRegistry g_structRegistry;
+
+void impl_InsertGlobalStructInfo(KNativePointer contextPtr, KStringPtr& instancePtr)
+{
+    g_structRegistry.Insert(instancePtr.c_str(), instancePtr.length());
 }
 KOALA_INTEROP_V2(InsertGlobalStructInfo, KNativePointer, KStringPtr);
 
 KBoolean impl_HasGlobalStructInfo(KNativePointer contextPtr, KStringPtr& instancePtr)
 {
-#ifdef _GLIBCXX_HAS_GTHREADS
-    std::lock_guard<std::mutex> lock(g_structMutex);
-#endif
-    return globalStructInfo.count(getStringCopy(instancePtr));
+    return g_structRegistry.Contains(instancePtr.c_str(), instancePtr.length());
 }
 KOALA_INTEROP_2(HasGlobalStructInfo, KBoolean, KNativePointer, KStringPtr);
 
+void impl_InsertGlobalStructInfos(KNativePointer contextPtr, const KStringArray& names, KInt count)
+{
+    size_t length = count > 0 ? std::min(static_cast<size_t>(count), names.size()) : 0;
+    for (size_t i = 0; i < length; i++) {
+        const char* name = names.get()[i];
+        g_structRegistry.Insert(name, strlen(name));
+    }
+}
+KOALA_INTEROP_V3(InsertGlobalStructInfos, KNativePointer, KStringArray, KInt);
+
+// 1 for every registered name, 0 otherwise and past the decoded names
+KInteropReturnBuffer impl_HasGlobalStructInfos(KNativePointer contextPtr, const KStringArray& names, KInt count)
+{
+    size_t length = count > 0 ? static_cast<size_t>(count) : 0;
+    auto* data = static_cast<int32_t*>(calloc(std::max<size_t>(length, 1), sizeof(int32_t)));
+    if (data == nullptr) {
+        return { 0, nullptr, nullptr, sizeof(int32_t) };
+    }
+    for (size_t i = 0; i < std::min(length, names.size()); i++) {
+        const char* name = names.get()[i];
+        data[i] = g_structRegistry.Contains(name, strlen(name)) ? 1 : 0;
+    }
+    return { static_cast<KInt>(length), data, DisposeMallocBuffer, sizeof(int32_t) };
+}
+KOALA_INTEROP_3(HasGlobalStructInfos, KInteropReturnBuffer, KNativePointer, KStringArray, KInt);
+
 KNativePointer impl_ETSParserGetGlobalProgramAbsName(KNativePointer contextPtr)
 {
     auto context = reinterpret_cast<es2panda_Context*>(contextPtr);
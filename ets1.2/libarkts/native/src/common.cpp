@@ -19,11 +19,15 @@
 #include <sstream>
 #include <utility>
 #include <vector>
+#include <algorithm>
 #include <bitset>
+#include <memory>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "interop-types.h"
 #include "memoryTracker.h"
+#include "peer-handles.h"
 
 using std::string, std::cout, std::endl, std::vector;
 constexpr int AST_NODE_TYPE_LIMIT = 256;
@@ -37,56 +41,294 @@ StageArena* StageArena::Instance()
     return &g_currentArena;
 }
 
-void StageArena::Add(void* pointer)
+size_t StageArena::ChunkHeaderSize()
 {
-    if (pointer)
-        allocated.push_back(pointer);
+    return (sizeof(Chunk) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+}
+
+void* StageArena::AllocSlow(size_t size, size_t align)
+{
+    if (size > MAX_ALLOC_SIZE || align > MAX_ALLOC_SIZE || (align & (align - 1)) != 0) {
+        INTEROP_FATAL("Cannot allocate memory");
+    }
+    // Oversized requests get a dedicated slab,
+    // so the remaining space in the current slab is not wasted.
+    bool dedicated = size + align > chunkSize / 2;
+    size_t payload = dedicated ? size + align : chunkSize;
+    auto* chunk = static_cast<Chunk*>(malloc(ChunkHeaderSize() + payload));
+    if (!chunk) {
+        INTEROP_FATAL("Cannot allocate memory");
+    }
+    chunk->size = payload;
+    char* begin = reinterpret_cast<char*>(chunk) + ChunkHeaderSize();
+    auto aligned = (reinterpret_cast<uintptr_t>(begin) + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+    if (dedicated) {
+        chunk->prev = large;
+        large = chunk;
+    } else {
+        chunk->prev = chunks;
+        chunks = chunk;
+        current = reinterpret_cast<char*>(aligned + size);
+        end = begin + payload;
+    }
+    totalSize += size;
+    return reinterpret_cast<void*>(aligned);
+}
+
+void* StageArena::AllocPinned(size_t size)
+{
+    if (size > MAX_ALLOC_SIZE) {
+        INTEROP_FATAL("Cannot allocate memory");
+    }
+    auto* chunk = static_cast<Chunk*>(malloc(ChunkHeaderSize() + size));
+    if (!chunk) {
+        INTEROP_FATAL("Cannot allocate memory");
+    }
+    chunk->size = size;
+    chunk->prev = pinned;
+    pinned = chunk;
+    return reinterpret_cast<char*>(chunk) + ChunkHeaderSize();
+}
+
+void StageArena::SetChunkSize(size_t size)
+{
+    chunkSize = std::max(std::min(size, static_cast<size_t>(MAX_ALLOC_SIZE)), MIN_CHUNK_SIZE);
+}
+
+void StageArena::Rollback(const Checkpoint& checkpoint)
+{
+    for (auto* finalizer = finalizers; finalizer != checkpoint.finalizers; finalizer = finalizer->next) {
+        if (finalizer == nullptr) {
+            INTEROP_FATAL("StageArena: rollback to a checkpoint which was already released");
+        }
+        finalizer->destroy(finalizer->object);
+    }
+    finalizers = checkpoint.finalizers;
+    while (large != checkpoint.large) {
+        Chunk* prev = large->prev;
+        free(large);
+        large = prev;
+    }
+    while (chunks != checkpoint.chunks) {
+        Chunk* prev = chunks->prev;
+        free(chunks);
+        chunks = prev;
+    }
+    current = checkpoint.current;
+    end = checkpoint.end;
+    totalSize = checkpoint.totalSize;
+    while (!scopes.empty() && scopes.back().totalSize > totalSize) {
+        scopes.pop_back();
+    }
+}
+
+size_t StageArena::OpenScope()
+{
+    scopes.push_back(Mark());
+    return scopes.size();
+}
+
+void StageArena::CloseScope(size_t depth)
+{
+    if (depth == 0 || depth > scopes.size()) {
+        return;
+    }
+    Checkpoint checkpoint = scopes[depth - 1];
+    scopes.resize(depth - 1);
+    Rollback(checkpoint);
 }
 
 void StageArena::Cleanup()
 {
-    if (totalSize > 0 && false)
-        printf("cleanup %d objects %d bytes\n", (int)allocated.size(), (int)totalSize);
-    for (auto it : allocated) {
-        free(it);
+    for (auto* finalizer = finalizers; finalizer != nullptr; finalizer = finalizer->next) {
+        finalizer->destroy(finalizer->object);
+    }
+    finalizers = nullptr;
+    scopes.clear();
+    while (large != nullptr) {
+        Chunk* prev = large->prev;
+        free(large);
+        large = prev;
+    }
+    while (pinned != nullptr) {
+        Chunk* prev = pinned->prev;
+        free(pinned);
+        pinned = prev;
+    }
+    // Keep the newest regular slab around to serve the next stage without hitting malloc.
+    Chunk* keep = nullptr;
+    Chunk* chunk = chunks;
+    while (chunk != nullptr) {
+        Chunk* prev = chunk->prev;
+        if (keep == nullptr && chunk->size == chunkSize) {
+            keep = chunk;
+        } else {
+            free(chunk);
+        }
+        chunk = prev;
+    }
+    chunks = keep;
+    if (keep != nullptr) {
+        keep->prev = nullptr;
+        current = reinterpret_cast<char*>(keep) + ChunkHeaderSize();
+        end = current + keep->size;
+    } else {
+        current = nullptr;
+        end = nullptr;
     }
     totalSize = 0;
-    allocated.clear();
 }
 
 StageArena::StageArena()
+    : chunks(nullptr), large(nullptr), pinned(nullptr), finalizers(nullptr), current(nullptr), end(nullptr), chunkSize(DEFAULT_CHUNK_SIZE), totalSize(0)
 {
-    totalSize = 0;
 }
 
 StageArena::~StageArena()
 {
     Cleanup();
+    free(chunks);
+    chunks = nullptr;
 }
 
+// Copies are handed to es2panda, which keeps them past any scope, so they live until Cleanup().
 char* StageArena::Strdup(const char* original)
 {
     auto* arena = StageArena::Instance();
     auto size = strlen(original) + 1;
-    char* memory = (char*)arena->Alloc(size);
+    char* memory = static_cast<char*>(arena->AllocPinned(size));
     interop_memory_copy(memory, size, original, size);
     return memory;
 }
 
-void* StageArena::Alloc(size_t size)
+static thread_local StringInterner g_stringInterner;
+constexpr size_t INTERNER_INITIAL_CAPACITY = 1024;
+// Longer strings are usually sources or messages which are rarely repeated.
+constexpr size_t INTERN_LENGTH_LIMIT = 256;
+
+StringInterner* StringInterner::Instance()
+{
+    return &g_stringInterner;
+}
+
+StringInterner::StringInterner() : current(nullptr), end(nullptr), count(0) {}
+
+StringInterner::~StringInterner()
 {
-    if (size > MAX_ALLOC_SIZE) {
-        INTEROP_FATAL("Cannot allocate memory");
+    Clear();
+}
+
+const StringInterner::Entry* StringInterner::Lookup(const char* data, size_t length, uint64_t hash) const
+{
+    if (table.empty()) {
+        return nullptr;
     }
-    void* result = malloc(size);
-    if (!result) {
-        INTEROP_FATAL("Cannot allocate memory");
+    size_t mask = table.size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask) {
+        const Entry& entry = table[index];
+        if (entry.data == nullptr) {
+            return &entry;
+        }
+        if (entry.hash == hash && entry.length == length && memcmp(entry.data, data, length) == 0) {
+            return &entry;
+        }
     }
-    totalSize += size;
-    Add(result);
+}
+
+char* StringInterner::Store(const char* data, size_t length)
+{
+    size_t size = length + 1;
+    if (current == nullptr || static_cast<size_t>(end - current) < size) {
+        size_t slabSize = std::max(SLAB_SIZE, size);
+        auto* slab = static_cast<char*>(malloc(slabSize));
+        if (!slab) {
+            INTEROP_FATAL("Cannot allocate memory");
+        }
+        slabs.push_back(slab);
+        current = slab;
+        end = slab + slabSize;
+    }
+    char* result = current;
+    if (length > 0) {
+        interop_memory_copy(result, size, data, length);
+    }
+    result[length] = '\0';
+    current += size;
     return result;
 }
 
+void StringInterner::Grow()
+{
+    std::vector<Entry> old(std::move(table));
+    table.assign(old.empty() ? INTERNER_INITIAL_CAPACITY : old.size() * 2, Entry { nullptr, 0, 0 });
+    size_t mask = table.size() - 1;
+    for (const auto& entry : old) {
+        if (entry.data == nullptr) {
+            continue;
+        }
+        size_t index = entry.hash & mask;
+        while (table[index].data != nullptr) {
+            index = (index + 1) & mask;
+        }
+        table[index] = entry;
+    }
+}
+
+const char* StringInterner::Intern(const char* data, size_t length)
+{
+    // Keep load factor below 3/4.
+    if ((count + 1) * 4 > table.size() * 3) {
+        Grow();
+    }
+    uint64_t hash = HashString(data, length);
+    auto* entry = const_cast<Entry*>(Lookup(data, length, hash));
+    if (entry->data == nullptr) {
+        *entry = Entry { Store(data, length), hash, length };
+        count++;
+    }
+    return entry->data;
+}
+
+const char* StringInterner::Find(const char* data, size_t length) const
+{
+    auto* entry = Lookup(data, length, HashString(data, length));
+    return entry != nullptr ? entry->data : nullptr;
+}
+
+void StringInterner::Clear()
+{
+    for (auto* slab : slabs) {
+        free(slab);
+    }
+    slabs.clear();
+    table.clear();
+    current = nullptr;
+    end = nullptr;
+    count = 0;
+}
+
+void impl_StageArenaSetChunkSize(KInt size)
+{
+    if (size > 0) {
+        StageArena::Instance()->SetChunkSize(static_cast<size_t>(size));
+    }
+}
+KOALA_INTEROP_V1(StageArenaSetChunkSize, KInt)
+
+KInt impl_StageArenaOpenScope()
+{
+    return static_cast<KInt>(StageArena::Instance()->OpenScope());
+}
+KOALA_INTEROP_0(StageArenaOpenScope, KInt)
+
+void impl_StageArenaCloseScope(KInt depth)
+{
+    if (depth > 0) {
+        StageArena::Instance()->CloseScope(static_cast<size_t>(depth));
+    }
+}
+KOALA_INTEROP_V1(StageArenaCloseScope, KInt)
+
 #ifdef KOALA_WINDOWS
 #include <windows.h>
 #define PLUGIN_DIR "windows_host_tools"
@@ -124,8 +366,6 @@ const char* DEFAULT_SDK_PATH = "../../../incremental/tools/panda/node_modules/@p
 
 const char* LIB_ES2PANDA_PUBLIC_ALT = LIB_PREFIX "es2panda-public" LIB_SUFFIX;
 const char* LIB_ES2PANDA_PUBLIC = LIB_PREFIX "es2panda_public" LIB_SUFFIX;
-const char* IS_UI_FLAG = "IS_UI_FLAG";
-const char* NOT_UI_FLAG = "NOT_UI_FLAG";
 const string MODULE_SUFFIX = ".d.ets";
 const string ARKUI = "arkui";
 
@@ -244,8 +484,44 @@ const char** getStringArray(KStringArray& ptr)
 
 char* getStringCopy(KStringPtr& ptr)
 {
-    return StageArena::Strdup(ptr.c_str() ? ptr.c_str() : "");
+    if (ptr.c_str() == nullptr) {
+        return const_cast<char*>(StringInterner::Instance()->Intern("", 0));
+    }
+    size_t length = ptr.length();
+    if (length <= INTERN_LENGTH_LIMIT && strlen(ptr.c_str()) == length) {
+        // es2panda does not modify the names we pass, so deduplicated copies are safe to share.
+        return const_cast<char*>(StringInterner::Instance()->Intern(ptr.c_str(), length));
+    }
+    return StageArena::Strdup(ptr.c_str());
+}
+
+const char* getInternedString(const KStringPtr& ptr)
+{
+    if (ptr.c_str() == nullptr) {
+        return StringInterner::Instance()->Intern("", 0);
+    }
+    return StringInterner::Instance()->Intern(ptr.c_str(), ptr.length());
+}
+
+KNativePointer impl_InternString(const KStringPtr& str)
+{
+    return const_cast<char*>(getInternedString(str));
 }
+KOALA_INTEROP_1(InternString, KNativePointer, KStringPtr)
+
+static void ClearQueryCache();
+static void ClearDeclarationCaches();
+static void InvalidateMutatedDeclarations(es2panda_Context* context, es2panda_AstNode* receiver);
+static void ClearClassHierarchies();
+static void ClearAnnotationIndexes();
+static void ReindexUpdatedAnnotations(es2panda_Context* context, es2panda_AstNode* newNode,
+    es2panda_AstNode* replacedNode);
+static std::vector<es2panda_AstNode*> SnapshotIndexedChildren(es2panda_Context* context, es2panda_AstNode* node);
+static void ReindexChangedChildren(es2panda_Context* context, es2panda_AstNode* node,
+    const std::vector<es2panda_AstNode*>& previous);
+static void ClearSkipPhasesIndexes();
+static void ClearAncestorIndexes();
+static void InvalidateClassHierarchy(es2panda_Context* context, es2panda_AstNode* declaration);
 
 void impl_DestroyConfig(KNativePointer config)
 {
@@ -254,6 +530,13 @@ void impl_DestroyConfig(KNativePointer config)
     // so keep arena alive until this moment.
     GetImpl()->DestroyConfig(_config);
     StageArena::Instance()->Cleanup();
+    ClearQueryCache();
+    ClearDeclarationCaches();
+    ClearClassHierarchies();
+    ClearAnnotationIndexes();
+    ClearSkipPhasesIndexes();
+    ClearAncestorIndexes();
+    StringInterner::Instance()->Clear();
 }
 KOALA_INTEROP_V1(DestroyConfig, KNativePointer)
 
@@ -264,12 +547,16 @@ void impl_ClassDefinitionSetBody(
     const auto _receiver = reinterpret_cast<es2panda_AstNode*>(receiver);
     const auto _body = reinterpret_cast<es2panda_AstNode**>(body);
     const auto _bodyLength = static_cast<KUInt>(bodyLength);
+    auto previous = SnapshotIndexedChildren(_context, _receiver);
     GetImpl()->ClassDefinitionClearBody(_context, _receiver);
     if (_body != nullptr) {
         for (size_t i = 0; i < _bodyLength; i++) {
             GetImpl()->ClassDefinitionEmplaceBody(_context, _receiver, _body[i]);
         }
     }
+    InvalidateClassHierarchy(_context, _receiver);
+    InvalidateMutatedDeclarations(_context, _receiver);
+    ReindexChangedChildren(_context, _receiver, previous);
 }
 KOALA_INTEROP_V4(ClassDefinitionSetBody, KNativePointer, KNativePointer, KNativePointerArray, KUInt)
 
@@ -278,11 +565,169 @@ Improve: NOT FROM API (shouldn't be there)
 ------------------------------------------------------------------------------------------------------------------------
 */
 
-es2panda_AstNode* cachedParentNode;
-es2panda_Context* cachedContext;
+/*
+ * Ancestor chains of one context: type, depth, nearest program node and the
+ * 2^k-th ancestors of every node a query climbed from. Chains already seen are
+ * answered without AstNodeTypeConst calls, common ancestors and containment are
+ * found by binary lifting. Entries mirror AstNodeParent: the bridges which set
+ * parents (OnUpdate, the repair bridges, splices and AstNodeSetParentTracked behind
+ * the AstNode.parent setter) bump the parent generation of the context when an
+ * indexed node gets another parent, and queries drop an index of an older
+ * generation. Parents set inside es2panda, e.g. by generated setters, are not seen,
+ * call AncestorIndexRelease after those.
+ */
+class AncestorIndex {
+public:
+    struct Entry {
+        es2panda_AstNode* node;
+        Entry* parent;
+        Entry* program; // nearest ancestor-or-self which is a program
+        Es2pandaAstNodeType type;
+        size_t depth;
+        std::vector<Entry*> jumps; // jumps[k] is the 2^k-th ancestor
+    };
+
+    Entry* Get(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* node)
+    {
+        if (node == nullptr) {
+            return nullptr;
+        }
+        auto it = entries.find(node);
+        if (it != entries.end()) {
+            return &it->second;
+        }
+        // Climb to the first indexed ancestor, then index the chain top-down
+        std::vector<es2panda_AstNode*> chain;
+        std::unordered_set<es2panda_AstNode*> seen;
+        Entry* top = nullptr;
+        for (auto* current = node; current != nullptr; current = impl->AstNodeParent(context, current)) {
+            auto found = entries.find(current);
+            if (found != entries.end()) {
+                top = &found->second;
+                break;
+            }
+            if (!seen.insert(current).second) {
+                break; // broken parent links form a cycle, treat the repeated node as the root
+            }
+            chain.push_back(current);
+        }
+        for (auto link = chain.rbegin(); link != chain.rend(); ++link) {
+            top = Add(impl, context, *link, top);
+        }
+        return top;
+    }
+
+    // Whether the node is indexed with another parent than the given one
+    bool IsStale(es2panda_AstNode* node, es2panda_AstNode* parent) const
+    {
+        auto it = entries.find(node);
+        return it != entries.end() && (it->second.parent ? it->second.parent->node : nullptr) != parent;
+    }
+
+    static Entry* Lift(Entry* entry, size_t depth)
+    {
+        size_t distance = entry->depth - depth;
+        for (size_t k = 0; distance != 0; k++, distance >>= 1) {
+            if ((distance & 1) != 0) {
+                entry = entry->jumps[k];
+            }
+        }
+        return entry;
+    }
+
+    static Entry* CommonAncestor(Entry* first, Entry* second)
+    {
+        if (first->depth > second->depth) {
+            first = Lift(first, second->depth);
+        } else {
+            second = Lift(second, first->depth);
+        }
+        if (first == second) {
+            return first;
+        }
+        // Entries of the same depth have the same number of jumps
+        for (size_t k = first->jumps.size(); k-- > 0;) {
+            if (k < first->jumps.size() && first->jumps[k] != second->jumps[k]) {
+                first = first->jumps[k];
+                second = second->jumps[k];
+            }
+        }
+        return first->parent == second->parent ? first->parent : nullptr;
+    }
+
+private:
+    Entry* Add(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* node, Entry* parent)
+    {
+        Entry& entry = entries[node];
+        entry.node = node;
+        entry.parent = parent;
+        entry.type = impl->AstNodeTypeConst(context, node);
+        entry.depth = parent ? parent->depth + 1 : 0;
+        entry.program = impl->AstNodeIsProgramConst(context, node) ? &entry : (parent ? parent->program : nullptr);
+        if (parent != nullptr) {
+            entry.jumps.push_back(parent);
+            while (entry.jumps.back()->jumps.size() >= entry.jumps.size()) {
+                entry.jumps.push_back(entry.jumps.back()->jumps[entry.jumps.size() - 1]);
+            }
+        }
+        return &entry;
+    }
+
+    std::unordered_map<es2panda_AstNode*, Entry> entries;
+
+public:
+    // Parent generation of the context the entries were built in
+    uint64_t generation = 0;
+
+    void Clear()
+    {
+        entries.clear();
+    }
+};
+
+static thread_local std::unordered_map<es2panda_Context*, AncestorIndex> g_ancestorIndexes;
+static thread_local std::unordered_map<es2panda_Context*, uint64_t> g_parentGenerations;
+
+// The index of the context, emptied if parents changed since it was built
+static AncestorIndex& AncestorIndexOf(es2panda_Context* context)
+{
+    auto& index = g_ancestorIndexes[context];
+    uint64_t generation = g_parentGenerations[context];
+    if (index.generation != generation) {
+        index.Clear();
+        index.generation = generation;
+    }
+    return index;
+}
+
+// Drops the index and the generation, also used when the context is destroyed
+static void ReleaseAncestorIndex(es2panda_Context* context)
+{
+    g_ancestorIndexes.erase(context);
+    g_parentGenerations.erase(context);
+}
+
+static void ClearAncestorIndexes()
+{
+    g_ancestorIndexes.clear();
+    g_parentGenerations.clear();
+}
+
+// Call before setting the parent of the node
+static void NoteParentChange(es2panda_Context* context, es2panda_AstNode* node, es2panda_AstNode* parent)
+{
+    auto it = g_ancestorIndexes.find(context);
+    if (it != g_ancestorIndexes.end() && it->second.IsStale(node, parent)) {
+        g_parentGenerations[context]++;
+    }
+}
+
+static thread_local es2panda_AstNode* cachedParentNode;
+static thread_local es2panda_Context* cachedContext;
 
 static void changeParent(es2panda_AstNode* child)
 {
+    NoteParentChange(cachedContext, child, cachedParentNode);
     GetImpl()->AstNodeSetParent(cachedContext, child, cachedParentNode);
 }
 
@@ -300,6 +745,7 @@ KNativePointer impl_AstNodeUpdateAll(KNativePointer contextPtr, KNativePointer p
     auto context = reinterpret_cast<es2panda_Context*>(contextPtr);
     auto program = reinterpret_cast<es2panda_AstNode*>(programPtr);
 
+    ReleaseAncestorIndex(context);
     GetImpl()->AstNodeForEach(program, SetRightParent, context);
     return program;
 }
@@ -309,12 +755,29 @@ void impl_AstNodeSetChildrenParentPtr(KNativePointer contextPtr, KNativePointer
 {
     auto context = reinterpret_cast<es2panda_Context*>(contextPtr);
     auto node = reinterpret_cast<es2panda_AstNode*>(nodePtr);
+    cachedContext = context;
     cachedParentNode = node;
 
     GetImpl()->AstNodeIterateConst(context, node, changeParent);
 }
 KOALA_INTEROP_V2(AstNodeSetChildrenParentPtr, KNativePointer, KNativePointer)
 
+// AstNodeSetParent which keeps the ancestor index of the context current
+void impl_AstNodeSetParentTracked(KNativePointer contextPtr, KNativePointer nodePtr, KNativePointer parentPtr)
+{
+    auto context = reinterpret_cast<es2panda_Context*>(contextPtr);
+    auto node = reinterpret_cast<es2panda_AstNode*>(nodePtr);
+    auto parent = reinterpret_cast<es2panda_AstNode*>(parentPtr);
+    NoteParentChange(context, node, parent);
+    GetImpl()->AstNodeSetParent(context, node, parent);
+}
+KOALA_INTEROP_V3(AstNodeSetParentTracked, KNativePointer, KNativePointer, KNativePointer)
+
+static void InvalidateUpdatedDeclarations(es2panda_Context* context, es2panda_AstNode* newNode,
+    es2panda_AstNode* replacedNode);
+static void InvalidateUpdatedClassHierarchy(es2panda_Context* context, es2panda_AstNode* newNode,
+    es2panda_AstNode* replacedNode);
+
 void impl_AstNodeOnUpdate(KNativePointer context, KNativePointer newNode, KNativePointer replacedNode)
 {
     auto _context = reinterpret_cast<es2panda_Context*>(context);
@@ -331,14 +794,138 @@ void impl_AstNodeOnUpdate(KNativePointer context, KNativePointer newNode, KNativ
     // Assign new node parent
     auto _parent = GetImpl()->AstNodeParent(_context, _replacedNode);
     if (_parent) {
+        NoteParentChange(_context, _newNode, _parent);
         GetImpl()->AstNodeSetParent(_context, _newNode, _parent);
     }
 
     // Redirect children parent pointer to this node
     impl_AstNodeSetChildrenParentPtr(context, newNode);
+
+    InvalidateUpdatedDeclarations(_context, _newNode, _replacedNode);
+    InvalidateUpdatedClassHierarchy(_context, _newNode, _replacedNode);
+    ReindexUpdatedAnnotations(_context, _newNode, _replacedNode);
 }
 KOALA_INTEROP_V3(AstNodeOnUpdate, KNativePointer, KNativePointer, KNativePointer)
 
+enum AstNodeListKind {
+    AST_NODE_LIST_CLASS_BODY,
+    AST_NODE_LIST_CLASS_IMPLEMENTS,
+    AST_NODE_LIST_BLOCK_STATEMENTS,
+    AST_NODE_LIST_FUNCTION_PARAMS,
+    AST_NODE_LIST_KIND_COUNT,
+};
+
+static es2panda_AstNode** GetAstNodeList(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* node,
+    AstNodeListKind kind, size_t* length)
+{
+    switch (kind) {
+        case AST_NODE_LIST_CLASS_BODY:
+            return impl->ClassDefinitionBody(context, node, length);
+        case AST_NODE_LIST_CLASS_IMPLEMENTS:
+            return impl->ClassDefinitionImplements(context, node, length);
+        case AST_NODE_LIST_BLOCK_STATEMENTS:
+            return impl->BlockStatementStatements(context, node, length);
+        case AST_NODE_LIST_FUNCTION_PARAMS:
+            return impl->ScriptFunctionParams(context, node, length);
+        default:
+            *length = 0;
+            return nullptr;
+    }
+}
+
+static void SetAstNodeList(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* node,
+    AstNodeListKind kind, std::vector<es2panda_AstNode*>& list)
+{
+    switch (kind) {
+        case AST_NODE_LIST_CLASS_BODY:
+            impl->ClassDefinitionClearBody(context, node);
+            for (auto* element : list) {
+                impl->ClassDefinitionEmplaceBody(context, node, element);
+            }
+            break;
+        case AST_NODE_LIST_CLASS_IMPLEMENTS:
+            impl->ClassDefinitionSetImplements(context, node, list.data(), list.size());
+            break;
+        case AST_NODE_LIST_BLOCK_STATEMENTS:
+            impl->BlockStatementSetStatements(context, node, list.data(), list.size());
+            break;
+        case AST_NODE_LIST_FUNCTION_PARAMS:
+            impl->ScriptFunctionSetParams(context, node, list.data(), list.size());
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Replaces deleteCount elements of the list from start with the items, like
+ * Array.prototype.splice. Class lists replace overlapping elements in place and
+ * append at the tail without rebuilding, other splices set the whole list once.
+ * Only the inserted items get their parent pointer set. Returns the new length,
+ * or -1 for an unknown list kind.
+ */
+KInt impl_AstNodeListSplice(KNativePointer context, KNativePointer receiver, KInt kind, KInt start,
+    KInt deleteCount, KNativePointerArray items, KInt itemsCount)
+{
+    auto* _context = reinterpret_cast<es2panda_Context*>(context);
+    auto* _receiver = reinterpret_cast<es2panda_AstNode*>(receiver);
+    auto** _items = reinterpret_cast<es2panda_AstNode**>(items);
+    if (_receiver == nullptr || kind < 0 || kind >= AST_NODE_LIST_KIND_COUNT) {
+        return -1;
+    }
+    auto _kind = static_cast<AstNodeListKind>(kind);
+    es2panda_Impl* impl = GetImpl();
+    size_t length = 0;
+    auto** list = GetAstNodeList(impl, _context, _receiver, _kind, &length);
+    if (list == nullptr) {
+        length = 0;
+    }
+    size_t from = std::min(static_cast<size_t>(std::max<KInt>(start, 0)), length);
+    size_t removed = std::min(static_cast<size_t>(std::max<KInt>(deleteCount, 0)), length - from);
+    size_t inserted = _items != nullptr && itemsCount > 0 ? static_cast<size_t>(itemsCount) : 0;
+    std::vector<es2panda_AstNode*> removedNodes(list + from, list + from + removed);
+
+    bool classList = _kind == AST_NODE_LIST_CLASS_BODY || _kind == AST_NODE_LIST_CLASS_IMPLEMENTS;
+    bool inPlace = removed == inserted || (inserted > removed && from + removed == length);
+    if (classList && inPlace) {
+        for (size_t i = 0; i < inserted; i++) {
+            if (i < removed && _kind == AST_NODE_LIST_CLASS_BODY) {
+                impl->ClassDefinitionSetValueBody(_context, _receiver, _items[i], from + i);
+            } else if (i < removed) {
+                impl->ClassDefinitionSetValueImplements(_context, _receiver, _items[i], from + i);
+            } else if (_kind == AST_NODE_LIST_CLASS_BODY) {
+                impl->ClassDefinitionEmplaceBody(_context, _receiver, _items[i]);
+            } else {
+                impl->ClassDefinitionEmplaceImplements(_context, _receiver, _items[i]);
+            }
+        }
+    } else if (removed != 0 || inserted != 0) {
+        std::vector<es2panda_AstNode*> result;
+        result.reserve(length - removed + inserted);
+        result.insert(result.end(), list, list + from);
+        result.insert(result.end(), _items, _items + inserted);
+        result.insert(result.end(), list + from + removed, list + length);
+        SetAstNodeList(impl, _context, _receiver, _kind, result);
+    }
+
+    for (size_t i = 0; i < inserted; i++) {
+        NoteParentChange(_context, _items[i], _receiver);
+        impl->AstNodeSetParent(_context, _items[i], _receiver);
+    }
+    if (classList) {
+        InvalidateClassHierarchy(_context, _receiver);
+    }
+    InvalidateMutatedDeclarations(_context, _receiver);
+    for (size_t i = 0; i < std::max(removed, inserted); i++) {
+        auto* insertedNode = i < inserted ? _items[i] : nullptr;
+        auto* removedNode = i < removed ? removedNodes[i] : nullptr;
+        InvalidateUpdatedDeclarations(_context, insertedNode, removedNode);
+        ReindexUpdatedAnnotations(_context, insertedNode, removedNode);
+    }
+    return static_cast<KInt>(length - removed + inserted);
+}
+KOALA_INTEROP_7(AstNodeListSplice, KInt, KNativePointer, KNativePointer, KInt, KInt, KInt, KNativePointerArray, KInt)
+
 KNativePointer impl_JumpFromETSTypeReferenceToTSTypeAliasDeclarationTypeAnnotation(
     KNativePointer context, KNativePointer etsTypeReference
 ) {
@@ -375,199 +962,430 @@ KNativePointer impl_AstNodeChildren(KNativePointer contextPtr, KNativePointer no
 }
 KOALA_INTEROP_2(AstNodeChildren, KNativePointer, KNativePointer, KNativePointer);
 
-struct Pattern {
-    es2panda_Context* context;
-    std::string key;
-    std::string value;
-    es2panda_Impl* impl;
-    bool isWildcard = false;
-    std::regex regex;
+// Children as peer handles of the context, 0 for a child left without one once the table is full
+KInteropReturnBuffer impl_AstNodeChildrenHandles(KNativePointer contextPtr, KNativePointer nodePtr)
+{
+    auto context = reinterpret_cast<es2panda_Context*>(contextPtr);
+    auto node = reinterpret_cast<es2panda_AstNode*>(nodePtr);
+    cachedContext = context;
+    cachedChildren.clear();
 
-    Pattern(const Pattern&) = delete;
-    Pattern& operator=(const Pattern&) = default;
+    GetImpl()->AstNodeIterateConst(context, node, visitChild);
+    auto* data = static_cast<int32_t*>(malloc(std::max<size_t>(cachedChildren.size(), 1) * sizeof(int32_t)));
+    if (data == nullptr) {
+        return { 0, nullptr, nullptr, sizeof(int32_t) };
+    }
+    auto* handles = PeerHandles::Instance();
+    for (size_t i = 0; i < cachedChildren.size(); i++) {
+        data[i] = handles->Acquire(context, cachedChildren[i]);
+    }
+    return { static_cast<KInt>(cachedChildren.size()), data, DisposeMallocBuffer, sizeof(int32_t) };
+}
+KOALA_INTEROP_2(AstNodeChildrenHandles, KInteropReturnBuffer, KNativePointer, KNativePointer)
 
-    Pattern(Pattern&& other) noexcept
-        : context(other.context),
-        key(std::move(other.key)),
-        value(std::move(other.value)),
-        impl(other.impl),
-        isWildcard(other.isWildcard),
-        regex(other.regex)
-        {
-            other.context = nullptr;
-            other.impl = nullptr;
-            other.isWildcard = false;
-        }
+KInt impl_AstNodeParentHandle(KNativePointer contextPtr, KNativePointer nodePtr)
+{
+    auto context = reinterpret_cast<es2panda_Context*>(contextPtr);
+    auto node = reinterpret_cast<es2panda_AstNode*>(nodePtr);
+    return PeerHandles::Instance()->Acquire(context, GetImpl()->AstNodeParent(context, node));
+}
+KOALA_INTEROP_2(AstNodeParentHandle, KInt, KNativePointer, KNativePointer)
 
-    Pattern& operator=(Pattern&& other) noexcept
-    {
-        context = other.context;
-        key = std::move(other.key);
-        value = std::move(other.value);
-        impl = other.impl;
-        isWildcard = other.isWildcard;
-        regex = other.regex;
-        other.context = nullptr;
-        other.impl = nullptr;
-        other.isWildcard = false;
-        return *this;
+/*
+ * Re-links parent pointers inside the given dirty subtrees only, plus the direct
+ * children of each root's parent so the root itself is linked from its parent too.
+ * Subtrees that are nested in an already repaired one are not walked again.
+ * Returns the number of visited nodes.
+ */
+KInt impl_AstNodeRepairParents(KNativePointer context, KNativePointerArray roots, KInt rootsCount)
+{
+    auto* _context = reinterpret_cast<es2panda_Context*>(context);
+    es2panda_Impl* impl = GetImpl();
+    ReleaseAncestorIndex(_context);
+    std::unordered_set<es2panda_AstNode*> visited;
+    std::vector<es2panda_AstNode*> stack;
+    std::vector<es2panda_AstNode*> children;
+    for (KInt i = 0; i < rootsCount; i++) {
+        auto* root = reinterpret_cast<es2panda_AstNode*>(roots[i]);
+        if (root == nullptr || !visited.insert(root).second) {
+            continue;
+        }
+        auto* parent = impl->AstNodeParent(_context, root);
+        if (parent != nullptr) {
+            cachedChildren.clear();
+            impl->AstNodeIterateConst(_context, parent, visitChild);
+            for (auto* child : cachedChildren) {
+                impl->AstNodeSetParent(_context, child, parent);
+            }
+        }
+        stack.push_back(root);
+        while (!stack.empty()) {
+            auto* node = stack.back();
+            stack.pop_back();
+            cachedChildren.clear();
+            impl->AstNodeIterateConst(_context, node, visitChild);
+            children.swap(cachedChildren);
+            for (auto* child : children) {
+                impl->AstNodeSetParent(_context, child, node);
+                if (visited.insert(child).second) {
+                    stack.push_back(child);
+                }
+            }
+            children.clear();
+        }
     }
+    return static_cast<KInt>(visited.size());
+}
+KOALA_INTEROP_3(AstNodeRepairParents, KInt, KNativePointer, KNativePointerArray, KInt)
 
-    Pattern(es2panda_Context* context, const std::string& part) : context(context), impl(GetImpl())
-    {
-        std::istringstream stream(part);
-        std::getline(stream, key, '=');
-        std::getline(stream, value, '=');
-        isWildcard = value.find('*') != std::string::npos;
-        if (isWildcard) {
-            this->regex = std::regex(value);
-        }
+static es2panda_AstNode** GetNodeAnnotations(
+    es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* node, Es2pandaAstNodeType type, size_t* length)
+{
+    switch (type) {
+        case Es2pandaAstNodeType::AST_NODE_TYPE_SCRIPT_FUNCTION:
+            return impl->ScriptFunctionAnnotations(context, node, length);
+        case Es2pandaAstNodeType::AST_NODE_TYPE_FUNCTION_DECLARATION:
+            return impl->FunctionDeclarationAnnotations(context, node, length);
+        case Es2pandaAstNodeType::AST_NODE_TYPE_ARROW_FUNCTION_EXPRESSION:
+            return impl->ArrowFunctionExpressionAnnotations(context, node, length);
+        case Es2pandaAstNodeType::AST_NODE_TYPE_ETS_FUNCTION_TYPE:
+            return impl->TypeNodeAnnotations(context, node, length);
+        case Es2pandaAstNodeType::AST_NODE_TYPE_TS_TYPE_ALIAS_DECLARATION:
+            return impl->TSTypeAliasDeclarationAnnotations(context, node, length);
+        case Es2pandaAstNodeType::AST_NODE_TYPE_VARIABLE_DECLARATION:
+            return impl->VariableDeclarationAnnotations(context, node, length);
+        case Es2pandaAstNodeType::AST_NODE_TYPE_ETS_UNION_TYPE:
+            return impl->TypeNodeAnnotations(context, node, length);
+        case Es2pandaAstNodeType::AST_NODE_TYPE_CLASS_PROPERTY:
+            return impl->ClassPropertyAnnotations(context, node, length);
+        case Es2pandaAstNodeType::AST_NODE_TYPE_ETS_PARAMETER_EXPRESSION:
+            return impl->ETSParameterExpressionAnnotations(context, node, length);
+        default:
+            *length = 0;
+            return nullptr;
     }
+}
 
-    ~Pattern() = default;
+static std::bitset<AST_NODE_TYPE_LIMIT> AnnotatedNodeTypes()
+{
+    std::bitset<AST_NODE_TYPE_LIMIT> types;
+    types.set(Es2pandaAstNodeType::AST_NODE_TYPE_SCRIPT_FUNCTION);
+    types.set(Es2pandaAstNodeType::AST_NODE_TYPE_FUNCTION_DECLARATION);
+    types.set(Es2pandaAstNodeType::AST_NODE_TYPE_ARROW_FUNCTION_EXPRESSION);
+    types.set(Es2pandaAstNodeType::AST_NODE_TYPE_ETS_FUNCTION_TYPE);
+    types.set(Es2pandaAstNodeType::AST_NODE_TYPE_TS_TYPE_ALIAS_DECLARATION);
+    types.set(Es2pandaAstNodeType::AST_NODE_TYPE_VARIABLE_DECLARATION);
+    types.set(Es2pandaAstNodeType::AST_NODE_TYPE_ETS_UNION_TYPE);
+    types.set(Es2pandaAstNodeType::AST_NODE_TYPE_CLASS_PROPERTY);
+    types.set(Es2pandaAstNodeType::AST_NODE_TYPE_ETS_PARAMETER_EXPRESSION);
+    return types;
+}
 
-    bool match(es2panda_AstNode* node) const
-    {
-        if (key == "type") {
-            return matchByType(node, impl->AstNodeTypeConst(context, node));
-        }
-        if (key == "annotation") {
-            return matchByAnnotation(node, impl->AstNodeTypeConst(context, node));
-        }
+// Type names accepted by "type=" and "parent=" query keys, a numeric Es2pandaAstNodeType is accepted as well.
+static bool ParseQueryNodeType(const std::string& name, std::bitset<AST_NODE_TYPE_LIMIT>& types)
+{
+    static const std::unordered_map<std::string, Es2pandaAstNodeType> NAMES = {
+        { "method", Es2pandaAstNodeType::AST_NODE_TYPE_METHOD_DEFINITION },
+        { "function", Es2pandaAstNodeType::AST_NODE_TYPE_SCRIPT_FUNCTION },
+        { "struct", Es2pandaAstNodeType::AST_NODE_TYPE_STRUCT_DECLARATION },
+        { "call", Es2pandaAstNodeType::AST_NODE_TYPE_CALL_EXPRESSION },
+        { "import", Es2pandaAstNodeType::AST_NODE_TYPE_ETS_IMPORT_DECLARATION },
+        { "assignment", Es2pandaAstNodeType::AST_NODE_TYPE_ASSIGNMENT_EXPRESSION },
+        { "class", Es2pandaAstNodeType::AST_NODE_TYPE_CLASS_DECLARATION },
+        { "classDefinition", Es2pandaAstNodeType::AST_NODE_TYPE_CLASS_DEFINITION },
+        { "property", Es2pandaAstNodeType::AST_NODE_TYPE_CLASS_PROPERTY },
+        { "interface", Es2pandaAstNodeType::AST_NODE_TYPE_TS_INTERFACE_DECLARATION },
+        { "identifier", Es2pandaAstNodeType::AST_NODE_TYPE_IDENTIFIER },
+        { "member", Es2pandaAstNodeType::AST_NODE_TYPE_MEMBER_EXPRESSION },
+        { "arrow", Es2pandaAstNodeType::AST_NODE_TYPE_ARROW_FUNCTION_EXPRESSION },
+        { "parameter", Es2pandaAstNodeType::AST_NODE_TYPE_ETS_PARAMETER_EXPRESSION },
+        { "variable", Es2pandaAstNodeType::AST_NODE_TYPE_VARIABLE_DECLARATION },
+        { "block", Es2pandaAstNodeType::AST_NODE_TYPE_BLOCK_STATEMENT },
+        { "new", Es2pandaAstNodeType::AST_NODE_TYPE_ETS_NEW_CLASS_INSTANCE_EXPRESSION },
+        { "module", Es2pandaAstNodeType::AST_NODE_TYPE_ETS_MODULE },
+    };
+    auto it = NAMES.find(name);
+    if (it != NAMES.end()) {
+        types.set(it->second);
+        return true;
+    }
+    if (name.empty() || name.find_first_not_of("0123456789") != std::string::npos || name.size() > 3) {
         return false;
     }
+    auto type = std::stoi(name);
+    if (type >= AST_NODE_TYPE_LIMIT) {
+        return false;
+    }
+    types.set(type);
+    return true;
+}
 
-    bool matchByType(es2panda_AstNode* node, Es2pandaAstNodeType type) const
-    {
-        switch (type) {
-            case Es2pandaAstNodeType::AST_NODE_TYPE_METHOD_DEFINITION:
-                return value == "method";
-            case Es2pandaAstNodeType::AST_NODE_TYPE_SCRIPT_FUNCTION:
-                return value == "function";
-            case Es2pandaAstNodeType::AST_NODE_TYPE_STRUCT_DECLARATION:
-                return value == "struct";
-            case Es2pandaAstNodeType::AST_NODE_TYPE_CALL_EXPRESSION:
-                return value == "call";
-            case Es2pandaAstNodeType::AST_NODE_TYPE_ETS_IMPORT_DECLARATION:
-                return value == "import";
-            case Es2pandaAstNodeType::AST_NODE_TYPE_ASSIGNMENT_EXPRESSION:
-                return value == "assignment";
-            default:
-                return false;
+static std::vector<std::string> SplitQuery(const std::string& value, char separator)
+{
+    std::vector<std::string> parts;
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        size_t end = value.find(separator, begin);
+        if (end == std::string::npos) {
+            end = value.size();
         }
+        if (end > begin) {
+            parts.emplace_back(value, begin, end - begin);
+        }
+        begin = end + 1;
     }
+    return parts;
+}
 
-    bool matchByAnnotation(es2panda_AstNode* node, Es2pandaAstNodeType type) const
-    {
-        std::size_t length = 0;
-        es2panda_AstNode** result = nullptr;
-        switch (type) {
-            case Es2pandaAstNodeType::AST_NODE_TYPE_SCRIPT_FUNCTION: {
-                result = impl->ScriptFunctionAnnotations(context, node, &length);
-                break;
+/*
+ * Query for FilterNodes compiled once per query string. Syntax is a ';'-separated
+ * list of "key=value" predicates which all have to match:
+ *   type=<types>        node type, e.g. "type=method|function"
+ *   parent=<types>      type of the parent node
+ *   annotation=<names>  node has one of the annotations, e.g. "annotation=State|Prop"
+ *   name=<names>        identifier name
+ *   depth=<n>           do not look deeper than n levels below the root
+ * Names containing '*' are matched as regular expressions.
+ */
+struct CompiledQuery {
+    enum class Opcode : uint8_t {
+        TYPE,
+        PARENT_TYPE,
+        ANNOTATION,
+        NAME,
+        NEVER,
+    };
+
+    struct NamePattern {
+        std::vector<uint64_t> hashes;
+        std::vector<std::string> names;
+        std::vector<std::regex> regexes;
+
+        bool Match(const char* value) const
+        {
+            if (value == nullptr) {
+                return false;
             }
-            case Es2pandaAstNodeType::AST_NODE_TYPE_FUNCTION_DECLARATION: {
-                result = impl->FunctionDeclarationAnnotations(context, node, &length);
-                break;
+            if (!names.empty()) {
+                size_t length = strlen(value);
+                if (names.size() == 1) {
+                    if (names[0].size() == length && memcmp(names[0].data(), value, length) == 0) {
+                        return true;
+                    }
+                } else {
+                    uint64_t hash = HashString(value, length);
+                    for (size_t i = 0; i < hashes.size(); i++) {
+                        if (hashes[i] == hash && names[i] == value) {
+                            return true;
+                        }
+                    }
+                }
             }
-            case Es2pandaAstNodeType::AST_NODE_TYPE_ARROW_FUNCTION_EXPRESSION: {
-                result = impl->ArrowFunctionExpressionAnnotations(context, node, &length);
-                break;
-            }
-            case Es2pandaAstNodeType::AST_NODE_TYPE_ETS_FUNCTION_TYPE: {
-                result = impl->TypeNodeAnnotations(context, node, &length);
-                break;
-            }
-            case Es2pandaAstNodeType::AST_NODE_TYPE_TS_TYPE_ALIAS_DECLARATION: {
-                result = impl->TSTypeAliasDeclarationAnnotations(context, node, &length);
-                break;
+            for (const auto& regex : regexes) {
+                if (std::regex_search(value, regex)) {
+                    return true;
+                }
             }
-            case Es2pandaAstNodeType::AST_NODE_TYPE_VARIABLE_DECLARATION: {
-                result = impl->VariableDeclarationAnnotations(context, node, &length);
-                break;
+            return false;
+        }
+    };
+
+    struct Instruction {
+        Opcode opcode;
+        std::bitset<AST_NODE_TYPE_LIMIT> types;
+        size_t pattern;
+    };
+
+    std::vector<Instruction> code;
+    std::vector<NamePattern> patterns;
+    // Node types which can possibly match, checked before running the code.
+    std::bitset<AST_NODE_TYPE_LIMIT> candidates;
+    int maxDepth = -1;
+
+    explicit CompiledQuery(const char* query)
+    {
+        candidates.set();
+        for (const auto& item : SplitQuery(query, ';')) {
+            Compile(item);
+        }
+    }
+
+    void Compile(const std::string& item)
+    {
+        auto separator = item.find('=');
+        std::string key = item.substr(0, separator);
+        std::string value = separator == std::string::npos ? "" : item.substr(separator + 1);
+        if (key == "depth") {
+            maxDepth = value.empty() ? -1 : std::max(0, std::atoi(value.c_str()));
+            return;
+        }
+        Instruction instruction { Opcode::NEVER, {}, 0 };
+        if (key == "type" || key == "parent") {
+            instruction.opcode = key == "type" ? Opcode::TYPE : Opcode::PARENT_TYPE;
+            for (const auto& name : SplitQuery(value, '|')) {
+                ParseQueryNodeType(name, instruction.types);
             }
-            case Es2pandaAstNodeType::AST_NODE_TYPE_ETS_UNION_TYPE: {
-                result = impl->TypeNodeAnnotations(context, node, &length);
-                break;
+            if (instruction.opcode == Opcode::TYPE) {
+                candidates &= instruction.types;
             }
-            case Es2pandaAstNodeType::AST_NODE_TYPE_CLASS_PROPERTY: {
-                result = impl->ClassPropertyAnnotations(context, node, &length);
-                break;
+        } else if (key == "annotation" || key == "name") {
+            instruction.opcode = key == "annotation" ? Opcode::ANNOTATION : Opcode::NAME;
+            instruction.pattern = patterns.size();
+            patterns.push_back(CompilePattern(value));
+            if (instruction.opcode == Opcode::ANNOTATION) {
+                static const auto ANNOTATED_TYPES = AnnotatedNodeTypes();
+                candidates &= ANNOTATED_TYPES;
+            } else {
+                candidates &= std::bitset<AST_NODE_TYPE_LIMIT>().set(Es2pandaAstNodeType::AST_NODE_TYPE_IDENTIFIER);
             }
-            case Es2pandaAstNodeType::AST_NODE_TYPE_ETS_PARAMETER_EXPRESSION: {
-                result = impl->ETSParameterExpressionAnnotations(context, node, &length);
-                break;
+        } else {
+            candidates.reset();
+        }
+        code.push_back(instruction);
+    }
+
+    static NamePattern CompilePattern(const std::string& value)
+    {
+        NamePattern pattern;
+        for (const auto& name : SplitQuery(value, '|')) {
+            if (name.find('*') != std::string::npos) {
+                pattern.regexes.emplace_back(name);
+            } else {
+                pattern.hashes.push_back(HashString(name.data(), name.size()));
+                pattern.names.push_back(name);
             }
-            default:
-                return false;
         }
+        return pattern;
+    }
 
-        bool found = false;
-        for (std::size_t i = 0; i < length && result; i++) {
-            es2panda_AstNode* ident = impl->AnnotationUsageIrGetBaseNameConst(context, result[i]);
-            found |= MatchWildcard(value, impl->IdentifierNameConst(context, ident));
+    bool Match(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* node, Es2pandaAstNodeType type,
+        Es2pandaAstNodeType parentType) const
+    {
+        if (type >= AST_NODE_TYPE_LIMIT || !candidates[type]) {
+            return false;
+        }
+        for (const auto& instruction : code) {
+            switch (instruction.opcode) {
+                case Opcode::TYPE:
+                    break;
+                case Opcode::PARENT_TYPE:
+                    if (parentType >= AST_NODE_TYPE_LIMIT || !instruction.types[parentType]) {
+                        return false;
+                    }
+                    break;
+                case Opcode::ANNOTATION:
+                    if (!MatchAnnotation(impl, context, node, type, patterns[instruction.pattern])) {
+                        return false;
+                    }
+                    break;
+                case Opcode::NAME:
+                    if (!patterns[instruction.pattern].Match(impl->IdentifierNameConst(context, node))) {
+                        return false;
+                    }
+                    break;
+                default:
+                    return false;
+            }
         }
-        return found;
+        return true;
     }
 
-    bool MatchWildcard(const std::string& pattern, const char* foundValue) const
+    static bool MatchAnnotation(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* node,
+        Es2pandaAstNodeType type, const NamePattern& pattern)
     {
-        if (!isWildcard) {
-            return pattern == foundValue;
+        size_t length = 0;
+        auto** annotations = GetNodeAnnotations(impl, context, node, type, &length);
+        for (size_t i = 0; i < length && annotations; i++) {
+            es2panda_AstNode* ident = impl->AnnotationUsageIrGetBaseNameConst(context, annotations[i]);
+            if (ident != nullptr && pattern.Match(impl->IdentifierNameConst(context, ident))) {
+                return true;
+            }
         }
+        return false;
+    }
+};
 
-        return std::regex_search(foundValue, this->regex);
+constexpr size_t QUERY_CACHE_LIMIT = 512;
+// Keyed by the interned query string, so it is released together with the interner.
+// Shared, so queries a caller still holds survive the cache being dropped when full.
+static thread_local std::unordered_map<const char*, std::shared_ptr<const CompiledQuery>> g_queryCache;
+
+static std::shared_ptr<const CompiledQuery> GetCompiledQuery(const KStringPtr& query)
+{
+    const char* key = getInternedString(query);
+    auto it = g_queryCache.find(key);
+    if (it != g_queryCache.end()) {
+        return it->second;
     }
+    if (g_queryCache.size() >= QUERY_CACHE_LIMIT) {
+        g_queryCache.clear();
+    }
+    return g_queryCache.emplace(key, std::make_shared<const CompiledQuery>(key)).first->second;
+}
+
+static void ClearQueryCache()
+{
+    g_queryCache.clear();
+}
+
+enum class WalkAction {
+    CONTINUE,
+    SKIP_CHILDREN,
+    STOP,
 };
 
-struct Matcher {
-    es2panda_Context* context;
-    const char* query;
-    std::vector<Pattern> patterns;
-    es2panda_Impl* impl;
-    Matcher(es2panda_Context* context, const char* query) : context(context), query(query), impl(GetImpl())
-    {
-        std::istringstream stream(query);
-        std::string item;
-        while (std::getline(stream, item, ';')) {
-            patterns.emplace_back(std::forward<Pattern>(Pattern(context, item)));
+/*
+ * Pre-order walk over the subtree with an explicit stack. The visitor gets
+ * (node, type, parentType, depth) and returns a WalkAction; the root has depth 0
+ * and parentType AST_NODE_TYPE_LIMIT if it has no parent.
+ */
+template<typename Visitor>
+static void WalkSubtree(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* root, int maxDepth,
+    Visitor&& visitor)
+{
+    struct Entry {
+        es2panda_AstNode* node;
+        Es2pandaAstNodeType parentType;
+        int depth;
+    };
+    auto* rootParent = impl->AstNodeParent(context, root);
+    auto noType = static_cast<Es2pandaAstNodeType>(AST_NODE_TYPE_LIMIT);
+    std::vector<Entry> stack;
+    stack.push_back({ root, rootParent ? impl->AstNodeTypeConst(context, rootParent) : noType, 0 });
+    while (!stack.empty()) {
+        auto current = stack.back();
+        stack.pop_back();
+        auto type = impl->AstNodeTypeConst(context, current.node);
+        auto action = visitor(current.node, type, current.parentType, current.depth);
+        if (action == WalkAction::STOP) {
+            return;
         }
-    }
-    bool match(es2panda_AstNode* node)
-    {
-        bool result = true;
-        for (const auto& pattern : patterns) {
-            result &= pattern.match(node);
+        if (action == WalkAction::SKIP_CHILDREN || (maxDepth >= 0 && current.depth >= maxDepth)) {
+            continue;
         }
-        return result;
+        impl->AstNodeIterateConst(context, current.node, visitChild);
+        for (auto it = cachedChildren.rbegin(); it != cachedChildren.rend(); ++it) {
+            stack.push_back({ *it, type, current.depth + 1 });
+        }
+        cachedChildren.clear();
     }
-};
+}
 
 static KNativePointer DoFilterNodes(es2panda_Context* _context,
                                     es2panda_AstNode* _node,
-                                    const char* _filters,
+                                    const CompiledQuery& query,
                                     bool deeperAfterMatch)
 {
     std::vector<es2panda_AstNode*> result;
     es2panda_Impl* impl = GetImpl();
-    Matcher matcher(_context, _filters);
-    std::vector<es2panda_AstNode*> queue;
-    queue.push_back(_node);
-    while (queue.size() > 0) {
-        auto* current = queue.back();
-        queue.pop_back();
-        bool isMatch = matcher.match(current);
-        if (isMatch) {
-            result.push_back(current);
-        }
-        if (!isMatch || deeperAfterMatch) {
-            impl->AstNodeIterateConst(_context, current, visitChild);
-            for (auto it = cachedChildren.rbegin(); it != cachedChildren.rend(); ++it) {
-                queue.push_back(*it);
+    WalkSubtree(impl, _context, _node, query.maxDepth,
+        [&](es2panda_AstNode* node, Es2pandaAstNodeType type, Es2pandaAstNodeType parentType, int depth) {
+            if (!query.Match(impl, _context, node, type, parentType)) {
+                return WalkAction::CONTINUE;
             }
-            cachedChildren.clear();
-        }
-    }
+            result.push_back(node);
+            return deeperAfterMatch ? WalkAction::CONTINUE : WalkAction::SKIP_CHILDREN;
+        });
     return StageArena::CloneVector(result.data(), result.size());
 }
 
@@ -576,10 +1394,589 @@ KNativePointer impl_FilterNodes(
 {
     auto* _node = reinterpret_cast<es2panda_AstNode*>(node);
     auto* _context = reinterpret_cast<es2panda_Context*>(context);
-    return DoFilterNodes(_context, _node, filters.c_str(), static_cast<bool>(deeperAfterMatch));
+    return DoFilterNodes(_context, _node, *GetCompiledQuery(filters), static_cast<bool>(deeperAfterMatch));
 }
 KOALA_INTEROP_4(FilterNodes, KNativePointer, KNativePointer, KNativePointer, KStringPtr, KBoolean)
 
+// Packs node lists as [count_0, ..., count_{n-1}, nodes of list 0..., nodes of list 1..., ...]
+template<typename Lists>
+static KNativePointer PackNodeGroups(const Lists& lists)
+{
+    auto* result = StageArena::Alloc<std::vector<const void*>>();
+    size_t total = lists.size();
+    for (const auto* list : lists) {
+        total += list ? list->size() : 0;
+    }
+    result->reserve(total);
+    for (const auto* list : lists) {
+        result->push_back(reinterpret_cast<const void*>(static_cast<uintptr_t>(list ? list->size() : 0)));
+    }
+    for (const auto* list : lists) {
+        if (list != nullptr) {
+            result->insert(result->end(), list->begin(), list->end());
+        }
+    }
+    return result;
+}
+
+/*
+ * Runs several queries in one walk. The result is packed as
+ * [count_0, ..., count_{n-1}, matches of query 0..., matches of query 1..., ...].
+ * A positive limit stops collecting matches of that query, the walk ends when
+ * every query reached its limit. Matching nodes are always descended into.
+ */
+KNativePointer impl_FilterNodesMulti(KNativePointer context, KNativePointer node, const KStringArray& queries,
+    KInt queriesCount, KInt* limits)
+{
+    auto* _node = reinterpret_cast<es2panda_AstNode*>(node);
+    auto* _context = reinterpret_cast<es2panda_Context*>(context);
+    es2panda_Impl* impl = GetImpl();
+    size_t count = queriesCount > 0 ? static_cast<size_t>(queriesCount) : 0;
+    // Queries past the decoded strings match nothing
+    size_t queried = std::min(count, queries.size());
+    std::vector<std::shared_ptr<const CompiledQuery>> compiled(queried);
+    std::vector<std::vector<es2panda_AstNode*>> matches(count);
+    int maxDepth = 0;
+    for (size_t i = 0; i < queried; i++) {
+        compiled[i] = GetCompiledQuery(KStringPtr(queries.get()[i], strlen(queries.get()[i]), false));
+        maxDepth = (maxDepth < 0 || compiled[i]->maxDepth < 0) ? -1 : std::max(maxDepth, compiled[i]->maxDepth);
+    }
+    size_t active = queried;
+    if (_node != nullptr && active > 0) {
+        WalkSubtree(impl, _context, _node, maxDepth,
+            [&](es2panda_AstNode* current, Es2pandaAstNodeType type, Es2pandaAstNodeType parentType, int depth) {
+                for (size_t i = 0; i < queried; i++) {
+                    size_t limit = (limits != nullptr && limits[i] > 0) ? static_cast<size_t>(limits[i]) : SIZE_MAX;
+                    const auto* query = compiled[i].get();
+                    if (matches[i].size() >= limit || (query->maxDepth >= 0 && depth > query->maxDepth)) {
+                        continue;
+                    }
+                    if (query->Match(impl, _context, current, type, parentType)) {
+                        matches[i].push_back(current);
+                        active -= matches[i].size() == limit ? 1 : 0;
+                    }
+                }
+                return active == 0 ? WalkAction::STOP : WalkAction::CONTINUE;
+            });
+    }
+    std::vector<const std::vector<es2panda_AstNode*>*> lists;
+    for (const auto& list : matches) {
+        lists.push_back(&list);
+    }
+    return PackNodeGroups(lists);
+}
+KOALA_INTEROP_5(FilterNodesMulti, KNativePointer, KNativePointer, KNativePointer, KStringArray, KInt, KInt*)
+
+/*
+ * Annotated nodes of one program, keyed by the interned annotation base name.
+ * Built in one walk on first query. Removal is lazy: the names of a dropped
+ * node are marked dirty and their lists are compacted on the next lookup.
+ */
+class AnnotationIndex {
+public:
+    void Build(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* root)
+    {
+        static const auto ANNOTATED_TYPES = AnnotatedNodeTypes();
+        WalkSubtree(impl, context, root, -1,
+            [&](es2panda_AstNode* node, Es2pandaAstNodeType type, Es2pandaAstNodeType, int) {
+                if (ANNOTATED_TYPES.test(type)) {
+                    Reindex(impl, context, node, type);
+                }
+                return WalkAction::CONTINUE;
+            });
+    }
+
+    // Re-reads the annotations of the node itself
+    void Reindex(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* node, Es2pandaAstNodeType type)
+    {
+        Remove(node);
+        size_t length = 0;
+        auto** annotations = GetNodeAnnotations(impl, context, node, type, &length);
+        for (size_t i = 0; annotations != nullptr && i < length; i++) {
+            auto* ident = impl->AnnotationUsageIrGetBaseNameConst(context, annotations[i]);
+            const char* name = ident ? impl->IdentifierNameConst(context, ident) : nullptr;
+            if (name == nullptr) {
+                continue;
+            }
+            const char* key = StringInterner::Instance()->Intern(name);
+            auto& names = namesOf[node];
+            if (std::find(names.begin(), names.end(), key) == names.end()) {
+                names.push_back(key);
+                byName[key].push_back(node);
+            }
+        }
+    }
+
+    void Remove(es2panda_AstNode* node)
+    {
+        auto it = namesOf.find(node);
+        if (it == namesOf.end()) {
+            return;
+        }
+        dirty.insert(it->second.begin(), it->second.end());
+        namesOf.erase(it);
+    }
+
+    bool Contains(es2panda_AstNode* node) const
+    {
+        return namesOf.count(node) > 0;
+    }
+
+    const std::vector<es2panda_AstNode*>* Find(const char* name)
+    {
+        auto it = byName.find(name);
+        if (it == byName.end()) {
+            return nullptr;
+        }
+        if (dirty.erase(name) > 0) {
+            Compact(name, it->second);
+        }
+        return &it->second;
+    }
+
+private:
+    // Drops nodes no longer annotated with the name and duplicates left by re-adding
+    void Compact(const char* name, std::vector<es2panda_AstNode*>& nodes) const
+    {
+        std::unordered_set<es2panda_AstNode*> seen;
+        nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [&](es2panda_AstNode* node) {
+            auto it = namesOf.find(node);
+            return it == namesOf.end() || std::find(it->second.begin(), it->second.end(), name) == it->second.end() ||
+                !seen.insert(node).second;
+        }), nodes.end());
+    }
+
+    std::unordered_map<const char*, std::vector<es2panda_AstNode*>> byName;
+    std::unordered_map<es2panda_AstNode*, std::vector<const char*>> namesOf;
+    std::unordered_set<const char*> dirty;
+};
+
+/*
+ * Indexes of one context by program root. Nodes that may have gained
+ * annotations outside an indexed node are queued and placed on the next query,
+ * sharing one root lookup per flush.
+ */
+struct AnnotationIndexes {
+    struct Pending {
+        es2panda_AstNode* node;
+        bool subtree;
+    };
+
+    void Remove(es2panda_AstNode* node)
+    {
+        for (auto& [root, index] : roots) {
+            index.Remove(node);
+        }
+    }
+
+    void RemoveSubtree(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* node)
+    {
+        WalkSubtree(impl, context, node, -1,
+            [&](es2panda_AstNode* current, Es2pandaAstNodeType, Es2pandaAstNodeType, int) {
+                Remove(current);
+                return WalkAction::CONTINUE;
+            });
+    }
+
+    void Flush(es2panda_Impl* impl, es2panda_Context* context)
+    {
+        static const auto ANNOTATED_TYPES = AnnotatedNodeTypes();
+        std::unordered_map<es2panda_AstNode*, es2panda_AstNode*> rootOf;
+        std::vector<es2panda_AstNode*> path;
+        for (const auto& [node, subtree] : pending) {
+            auto index = roots.find(RootOf(impl, context, node, rootOf, path));
+            if (index == roots.end()) {
+                continue;
+            }
+            if (subtree) {
+                index->second.Build(impl, context, node);
+                continue;
+            }
+            auto type = impl->AstNodeTypeConst(context, node);
+            if (ANNOTATED_TYPES.test(type)) {
+                index->second.Reindex(impl, context, node, type);
+            }
+        }
+        pending.clear();
+    }
+
+    std::unordered_map<es2panda_AstNode*, AnnotationIndex> roots;
+    std::vector<Pending> pending;
+
+private:
+    // Climbs to the root, recording it for every node on the way
+    static es2panda_AstNode* RootOf(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* node,
+        std::unordered_map<es2panda_AstNode*, es2panda_AstNode*>& rootOf, std::vector<es2panda_AstNode*>& path)
+    {
+        path.clear();
+        es2panda_AstNode* root = nullptr;
+        for (auto* current = node; root == nullptr;) {
+            auto known = rootOf.find(current);
+            if (known != rootOf.end()) {
+                root = known->second;
+                break;
+            }
+            path.push_back(current);
+            auto* parent = impl->AstNodeParent(context, current);
+            if (parent == nullptr) {
+                root = current;
+            }
+            current = parent;
+        }
+        for (auto* visited : path) {
+            rootOf[visited] = root;
+        }
+        return root;
+    }
+};
+
+static thread_local std::unordered_map<es2panda_Context*, AnnotationIndexes> g_annotationIndexes;
+
+static void QueueAnnotationUpdate(es2panda_Context* context, es2panda_AstNode* node, bool subtree)
+{
+    auto it = g_annotationIndexes.find(context);
+    if (it != g_annotationIndexes.end() && node != nullptr) {
+        it->second.pending.push_back({ node, subtree });
+    }
+}
+
+// Children of the node before an in-place change, empty while no annotation index is live
+static std::vector<es2panda_AstNode*> SnapshotIndexedChildren(es2panda_Context* context, es2panda_AstNode* node)
+{
+    if (g_annotationIndexes.count(context) == 0) {
+        return {};
+    }
+    std::vector<es2panda_AstNode*> children;
+    cachedChildren.clear();
+    GetImpl()->AstNodeIterateConst(context, node, visitChild);
+    children.swap(cachedChildren);
+    return children;
+}
+
+// Drops the subtrees of children missing since the snapshot and queues the ones the node gained
+static void ReindexChangedChildren(es2panda_Context* context, es2panda_AstNode* node,
+    const std::vector<es2panda_AstNode*>& previous)
+{
+    auto it = g_annotationIndexes.find(context);
+    if (it == g_annotationIndexes.end()) {
+        return;
+    }
+    es2panda_Impl* impl = GetImpl();
+    std::unordered_set<es2panda_AstNode*> dropped(previous.begin(), previous.end());
+    std::vector<es2panda_AstNode*> gained;
+    cachedChildren.clear();
+    impl->AstNodeIterateConst(context, node, visitChild);
+    for (auto* child : cachedChildren) {
+        if (dropped.erase(child) == 0) {
+            gained.push_back(child);
+        }
+    }
+    // WalkSubtree expects the shared buffer empty
+    cachedChildren.clear();
+    for (auto* child : dropped) {
+        it->second.RemoveSubtree(impl, context, child);
+    }
+    for (auto* child : gained) {
+        QueueAnnotationUpdate(context, child, true);
+    }
+}
+
+/*
+ * Only the changed part of an update is re-read: children the new node dropped
+ * leave the indexes with their subtrees, children it gained are queued with
+ * theirs, and the node itself is queued alone. Descendants shared by both keep
+ * their entries.
+ */
+static void ReindexUpdatedAnnotations(es2panda_Context* context, es2panda_AstNode* newNode,
+    es2panda_AstNode* replacedNode)
+{
+    auto it = g_annotationIndexes.find(context);
+    if (it == g_annotationIndexes.end()) {
+        return;
+    }
+    if (newNode == nullptr || replacedNode == nullptr) {
+        if (replacedNode != nullptr) {
+            it->second.RemoveSubtree(GetImpl(), context, replacedNode);
+        }
+        QueueAnnotationUpdate(context, newNode, true);
+        return;
+    }
+    ReindexChangedChildren(context, newNode, SnapshotIndexedChildren(context, replacedNode));
+    it->second.Remove(replacedNode);
+    QueueAnnotationUpdate(context, newNode, false);
+}
+
+static void ClearAnnotationIndexes()
+{
+    g_annotationIndexes.clear();
+}
+
+/*
+ * Nodes under the program root annotated with each of the names, packed as in
+ * FilterNodesMulti. The index of the root is built on the first query.
+ */
+KNativePointer impl_AnnotationIndexQuery(KNativePointer context, KNativePointer root, const KStringArray& names,
+    KInt namesCount)
+{
+    auto* _context = reinterpret_cast<es2panda_Context*>(context);
+    auto* _root = reinterpret_cast<es2panda_AstNode*>(root);
+    es2panda_Impl* impl = GetImpl();
+    size_t count = namesCount > 0 ? static_cast<size_t>(namesCount) : 0;
+    std::vector<const std::vector<es2panda_AstNode*>*> lists(count, nullptr);
+    if (_root == nullptr) {
+        return PackNodeGroups(lists);
+    }
+    auto& indexes = g_annotationIndexes[_context];
+    indexes.Flush(impl, _context);
+    auto it = indexes.roots.find(_root);
+    if (it == indexes.roots.end()) {
+        it = indexes.roots.emplace(_root, AnnotationIndex()).first;
+        it->second.Build(impl, _context, _root);
+    }
+    auto* interner = StringInterner::Instance();
+    // Names past the decoded strings have no matches
+    for (size_t i = 0; i < std::min(count, names.size()); i++) {
+        const char* name = interner->Find(names.get()[i], strlen(names.get()[i]));
+        lists[i] = name ? it->second.Find(name) : nullptr;
+    }
+    return PackNodeGroups(lists);
+}
+KOALA_INTEROP_4(AnnotationIndexQuery, KNativePointer, KNativePointer, KNativePointer, KStringArray, KInt)
+
+// Re-reads the annotations of the node and its descendants on the next query
+void impl_AnnotationIndexUpdate(KNativePointer context, KNativePointer node)
+{
+    QueueAnnotationUpdate(reinterpret_cast<es2panda_Context*>(context), reinterpret_cast<es2panda_AstNode*>(node),
+        true);
+}
+KOALA_INTEROP_V2(AnnotationIndexUpdate, KNativePointer, KNativePointer)
+
+void impl_AnnotationIndexRelease(KNativePointer context)
+{
+    g_annotationIndexes.erase(reinterpret_cast<es2panda_Context*>(context));
+}
+KOALA_INTEROP_V1(AnnotationIndexRelease, KNativePointer)
+
+/*
+ * setAnnotations of every annotated node type, the index entry of the node is
+ * re-read in place. Only TypeNode subclasses reach the default branch.
+ */
+void impl_AstNodeSetAnnotations(
+    KNativePointer context, KNativePointer receiver, KNativePointerArray annotations, KUInt annotationsLength)
+{
+    auto* _context = reinterpret_cast<es2panda_Context*>(context);
+    auto* _receiver = reinterpret_cast<es2panda_AstNode*>(receiver);
+    auto** _annotations = reinterpret_cast<es2panda_AstNode**>(annotations);
+    auto _length = static_cast<size_t>(annotationsLength);
+    es2panda_Impl* impl = GetImpl();
+    auto type = impl->AstNodeTypeConst(_context, _receiver);
+    switch (type) {
+        case Es2pandaAstNodeType::AST_NODE_TYPE_SCRIPT_FUNCTION:
+            impl->ScriptFunctionSetAnnotations(_context, _receiver, _annotations, _length);
+            break;
+        case Es2pandaAstNodeType::AST_NODE_TYPE_FUNCTION_DECLARATION:
+            impl->FunctionDeclarationSetAnnotations(_context, _receiver, _annotations, _length);
+            break;
+        case Es2pandaAstNodeType::AST_NODE_TYPE_ARROW_FUNCTION_EXPRESSION:
+            impl->ArrowFunctionExpressionSetAnnotations(_context, _receiver, _annotations, _length);
+            break;
+        case Es2pandaAstNodeType::AST_NODE_TYPE_TS_TYPE_ALIAS_DECLARATION:
+            impl->TSTypeAliasDeclarationSetAnnotations(_context, _receiver, _annotations, _length);
+            break;
+        case Es2pandaAstNodeType::AST_NODE_TYPE_VARIABLE_DECLARATION:
+            impl->VariableDeclarationSetAnnotations(_context, _receiver, _annotations, _length);
+            break;
+        case Es2pandaAstNodeType::AST_NODE_TYPE_CLASS_PROPERTY:
+            impl->ClassPropertySetAnnotations(_context, _receiver, _annotations, _length);
+            break;
+        case Es2pandaAstNodeType::AST_NODE_TYPE_ETS_PARAMETER_EXPRESSION:
+            impl->ETSParameterExpressionSetAnnotations(_context, _receiver, _annotations, _length);
+            break;
+        default:
+            impl->TypeNodeSetAnnotations(_context, _receiver, _annotations, _length);
+            break;
+    }
+    auto it = g_annotationIndexes.find(_context);
+    if (it == g_annotationIndexes.end()) {
+        return;
+    }
+    static const auto ANNOTATED_TYPES = AnnotatedNodeTypes();
+    for (auto& [root, index] : it->second.roots) {
+        if (index.Contains(_receiver)) {
+            if (ANNOTATED_TYPES.test(type)) {
+                index.Reindex(impl, _context, _receiver, type);
+            } else {
+                index.Remove(_receiver);
+            }
+            return;
+        }
+    }
+    QueueAnnotationUpdate(_context, _receiver, false);
+}
+KOALA_INTEROP_V4(AstNodeSetAnnotations, KNativePointer, KNativePointer, KNativePointerArray, KUInt)
+
+enum AstSnapshotField {
+    SNAPSHOT_TYPE,
+    SNAPSHOT_PARENT,
+    SNAPSHOT_FIRST_CHILD,
+    SNAPSHOT_NEXT_SIBLING,
+    SNAPSHOT_START,
+    SNAPSHOT_END,
+    SNAPSHOT_FIELD_COUNT,
+};
+
+void DisposeMallocBuffer(KNativePointer data, KInt)
+{
+    free(data);
+}
+
+/*
+ * Flattens the subtree into one buffer of 64-bit words:
+ * [count, peer_0..peer_{n-1}, then SNAPSHOT_FIELD_COUNT int32 columns of length n].
+ * Nodes are numbered in pre-order, so the root is 0; missing links are -1 and
+ * positions are source indices. The buffer is owned by the JS side.
+ */
+KInteropReturnBuffer impl_AstNodeSnapshot(KNativePointer context, KNativePointer node)
+{
+    auto* _context = reinterpret_cast<es2panda_Context*>(context);
+    auto* _node = reinterpret_cast<es2panda_AstNode*>(node);
+    es2panda_Impl* impl = GetImpl();
+    std::vector<es2panda_AstNode*> peers;
+    std::vector<int32_t> columns[SNAPSHOT_FIELD_COUNT];
+    std::vector<int32_t> lastChild;
+    std::vector<std::pair<es2panda_AstNode*, int32_t>> stack;
+    if (_node != nullptr) {
+        stack.emplace_back(_node, -1);
+    }
+    while (!stack.empty()) {
+        auto [current, parent] = stack.back();
+        stack.pop_back();
+        auto index = static_cast<int32_t>(peers.size());
+        peers.push_back(current);
+        const auto* range = impl->AstNodeRangeConst(_context, current);
+        auto* _range = const_cast<es2panda_SourceRange*>(range);
+        columns[SNAPSHOT_TYPE].push_back(impl->AstNodeTypeConst(_context, current));
+        columns[SNAPSHOT_PARENT].push_back(parent);
+        columns[SNAPSHOT_FIRST_CHILD].push_back(-1);
+        columns[SNAPSHOT_NEXT_SIBLING].push_back(-1);
+        columns[SNAPSHOT_START].push_back(
+            _range ? impl->SourcePositionIndex(_context, impl->SourceRangeStart(_context, _range)) : -1);
+        columns[SNAPSHOT_END].push_back(
+            _range ? impl->SourcePositionIndex(_context, impl->SourceRangeEnd(_context, _range)) : -1);
+        lastChild.push_back(-1);
+        if (parent >= 0) {
+            auto& previous = lastChild[parent];
+            (previous < 0 ? columns[SNAPSHOT_FIRST_CHILD][parent] : columns[SNAPSHOT_NEXT_SIBLING][previous]) = index;
+            previous = index;
+        }
+        impl->AstNodeIterateConst(_context, current, visitChild);
+        for (auto it = cachedChildren.rbegin(); it != cachedChildren.rend(); ++it) {
+            stack.emplace_back(*it, index);
+        }
+        cachedChildren.clear();
+    }
+    size_t count = peers.size();
+    size_t words = 1 + count + (count * SNAPSHOT_FIELD_COUNT + 1) / 2;
+    auto* data = static_cast<uint64_t*>(calloc(words, sizeof(uint64_t)));
+    if (data == nullptr) {
+        return { 0, nullptr, nullptr, sizeof(uint64_t) };
+    }
+    data[0] = count;
+    for (size_t i = 0; i < count; i++) {
+        data[1 + i] = reinterpret_cast<uintptr_t>(peers[i]);
+    }
+    auto* fields = reinterpret_cast<int32_t*>(data + 1 + count);
+    for (const auto& column : columns) {
+        std::copy(column.begin(), column.end(), fields);
+        fields += count;
+    }
+    return { static_cast<KInt>(words), data, DisposeMallocBuffer, sizeof(uint64_t) };
+}
+KOALA_INTEROP_2(AstNodeSnapshot, KInteropReturnBuffer, KNativePointer, KNativePointer)
+
+template<typename T, typename Getter>
+static KInteropReturnBuffer MapPeers(KNativePointerArray peers, KInt count, Getter&& getter)
+{
+    size_t length = count > 0 ? static_cast<size_t>(count) : 0;
+    auto* data = static_cast<T*>(malloc(std::max<size_t>(length, 1) * sizeof(T)));
+    if (data == nullptr) {
+        return { 0, nullptr, nullptr, sizeof(T) };
+    }
+    for (size_t i = 0; i < length; i++) {
+        data[i] = peers[i] ? getter(reinterpret_cast<es2panda_AstNode*>(peers[i])) : T {};
+    }
+    return { static_cast<KInt>(length), data, DisposeMallocBuffer, sizeof(T) };
+}
+
+// Node types of the peers, AST_NODE_TYPE_LIMIT for null entries.
+KInteropReturnBuffer impl_AstNodeTypes(KNativePointer context, KNativePointerArray peers, KInt count)
+{
+    auto* _context = reinterpret_cast<es2panda_Context*>(context);
+    es2panda_Impl* impl = GetImpl();
+    auto result = MapPeers<int32_t>(peers, count, [&](es2panda_AstNode* node) {
+        return static_cast<int32_t>(impl->AstNodeTypeConst(_context, node));
+    });
+    for (KInt i = 0; i < result.length; i++) {
+        if (peers[i] == nullptr) {
+            static_cast<int32_t*>(result.data)[i] = AST_NODE_TYPE_LIMIT;
+        }
+    }
+    return result;
+}
+KOALA_INTEROP_3(AstNodeTypes, KInteropReturnBuffer, KNativePointer, KNativePointerArray, KInt)
+
+KInteropReturnBuffer impl_AstNodeParents(KNativePointer context, KNativePointerArray peers, KInt count)
+{
+    auto* _context = reinterpret_cast<es2panda_Context*>(context);
+    es2panda_Impl* impl = GetImpl();
+    return MapPeers<uint64_t>(peers, count, [&](es2panda_AstNode* node) {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(impl->AstNodeParent(_context, node)));
+    });
+}
+KOALA_INTEROP_3(AstNodeParents, KInteropReturnBuffer, KNativePointer, KNativePointerArray, KInt)
+
+// Bit i of the AstNodePredicates result is the i-th predicate, keep in sync with AstNodePredicate in public.ts.
+static decltype(&es2panda_Impl::AstNodeIsExpressionConst) const g_nodePredicates[] = {
+    &es2panda_Impl::AstNodeIsExpressionConst,
+    &es2panda_Impl::AstNodeIsStatementConst,
+    &es2panda_Impl::AstNodeIsTypedConst,
+    &es2panda_Impl::AstNodeIsScopeBearerConst,
+    &es2panda_Impl::AstNodeIsExportedConst,
+    &es2panda_Impl::AstNodeIsDefaultExportedConst,
+    &es2panda_Impl::AstNodeIsDeclareConst,
+    &es2panda_Impl::AstNodeIsStaticConst,
+    &es2panda_Impl::AstNodeIsPublicConst,
+    &es2panda_Impl::AstNodeIsPrivateConst,
+    &es2panda_Impl::AstNodeIsProtectedConst,
+    &es2panda_Impl::AstNodeIsReadonlyConst,
+    &es2panda_Impl::AstNodeIsAbstractConst,
+    &es2panda_Impl::AstNodeIsFinalConst,
+    &es2panda_Impl::AstNodeIsAsyncConst,
+    &es2panda_Impl::AstNodeIsConstructorConst,
+    &es2panda_Impl::AstNodeIsOverrideConst,
+    &es2panda_Impl::AstNodeIsOptionalDeclarationConst,
+};
+
+/*
+ * Evaluates the predicates selected by mask for every peer and returns one
+ * bit set per peer. Null peers yield 0.
+ */
+KInteropReturnBuffer impl_AstNodePredicates(KNativePointer context, KNativePointerArray peers, KInt count, KInt mask)
+{
+    auto* _context = reinterpret_cast<es2panda_Context*>(context);
+    es2panda_Impl* impl = GetImpl();
+    return MapPeers<int32_t>(peers, count, [&](es2panda_AstNode* node) {
+        int32_t bits = 0;
+        for (size_t i = 0; i < std::size(g_nodePredicates); i++) {
+            if ((mask & (1 << i)) != 0 && (impl->*g_nodePredicates[i])(_context, node)) {
+                bits |= 1 << i;
+            }
+        }
+        return bits;
+    });
+}
+KOALA_INTEROP_4(AstNodePredicates, KInteropReturnBuffer, KNativePointer, KNativePointerArray, KInt, KInt)
+
 struct FilterArgs {
     es2panda_Impl *impl;
     es2panda_Context *context;
@@ -626,54 +2023,39 @@ KNativePointer impl_FilterNodes3(KNativePointer context, KNativePointer node, KI
 }
 KOALA_INTEROP_4(FilterNodes3, KNativePointer, KNativePointer, KNativePointer, KInt*, KInt)
 
+static bool MergeAnnotationProperties(es2panda_Context* context, es2panda_AstNode* annotationUsage,
+    std::vector<es2panda_AstNode*>& merged);
+
+// Declaration properties of the annotation, overridden by the usage properties of the same name
 KNativePointer impl_GetAnnotationDeclarationProperties(KNativePointer contextPtr, KNativePointer annotationUsagePtr)
 {
     const auto _context = reinterpret_cast<es2panda_Context*>(contextPtr);
     const auto _annotationUsage = reinterpret_cast<es2panda_AstNode*>(annotationUsagePtr);
-    if (!GetImpl()->IsAnnotationUsage(_annotationUsage)) {
+    std::vector<es2panda_AstNode*> merged;
+    if (!MergeAnnotationProperties(_context, _annotationUsage, merged)) {
         return nullptr;
     }
-    size_t usagePropsLen = 0;
-    auto **usageProps = GetImpl()->AnnotationUsageIrPropertiesConst(_context, _annotationUsage, &usagePropsLen);
-    auto *expr = GetImpl()->AnnotationUsageIrExpr(_context, _annotationUsage);
-    if (expr == nullptr || !GetImpl()->IsIdentifier(expr)) {
-        return nullptr;
-    }
-    auto *variable = GetImpl()->AstNodeVariableConst(_context, expr);
-    if (variable == nullptr) {
-        return nullptr;
-    }
-    auto *decl = GetImpl()->VariableDeclaration(_context, variable);
-    if (decl == nullptr) {
-        return nullptr;
-    }
-    auto *declNode = GetImpl()->DeclNode(_context, decl);
-    if (declNode == nullptr) {
-        return nullptr;
-    }
-    size_t declPropsLen = 0;
-    auto **declProps = GetImpl()->AnnotationDeclarationPropertiesConst(_context, declNode, &declPropsLen);
-    if (declProps == nullptr) {
-        return nullptr;
-    }
-    auto mergedProperties = new std::vector<void*>();
-    for (size_t i = 0; i < declPropsLen; i++) {
-        auto *declPropKey = GetImpl()->ClassElementKey(_context, declProps[i]);
-        const char *declPropName = GetImpl()->IdentifierName(_context, declPropKey);
-        void *selectedProp = declProps[i];
-        for (size_t j = 0; j < usagePropsLen; j++) {
-            auto *usagePropKey = GetImpl()->ClassElementKey(_context, usageProps[j]);
-            const char *usagePropName = GetImpl()->IdentifierName(_context, usagePropKey);
-            if (strcmp(declPropName, usagePropName) == 0) {
-                selectedProp = usageProps[j];
-                break;
-            }
+    return StageArena::CloneVector(merged.data(), merged.size());
+}
+KOALA_INTEROP_2(GetAnnotationDeclarationProperties, KNativePointer, KNativePointer, KNativePointer);
+
+// Merged properties of every usage packed as node groups, unresolved usages give empty groups
+KNativePointer impl_GetAnnotationDeclarationPropertiesBatch(KNativePointer contextPtr,
+    KNativePointerArray annotationUsages, KInt count)
+{
+    const auto _context = reinterpret_cast<es2panda_Context*>(contextPtr);
+    size_t _count = count > 0 ? static_cast<size_t>(count) : 0;
+    std::vector<std::vector<es2panda_AstNode*>> merged(_count);
+    std::vector<const std::vector<es2panda_AstNode*>*> groups(_count, nullptr);
+    for (size_t i = 0; i < _count; i++) {
+        auto* usage = reinterpret_cast<es2panda_AstNode*>(annotationUsages[i]);
+        if (usage != nullptr && MergeAnnotationProperties(_context, usage, merged[i])) {
+            groups[i] = &merged[i];
         }
-        mergedProperties->push_back(selectedProp);
     }
-    return mergedProperties;
+    return PackNodeGroups(groups);
 }
-KOALA_INTEROP_2(GetAnnotationDeclarationProperties, KNativePointer, KNativePointer, KNativePointer);
+KOALA_INTEROP_3(GetAnnotationDeclarationPropertiesBatch, KNativePointer, KNativePointer, KNativePointerArray, KInt)
 
 /*
 ------------------------------------------------------------------------------------------------------------------------
@@ -684,54 +2066,139 @@ KOALA_INTEROP_2(GetAnnotationDeclarationProperties, KNativePointer, KNativePoint
 
 static bool isUIHeaderFile(es2panda_Context* context, es2panda_Program* program)
 {
-    auto result = GetImpl()->ProgramFileNameWithExtensionConst(context, program);
-    string fileNameWithExtension(result);
-    result = GetImpl()->ProgramModuleNameConst(context, program);
-    string moduleName(result);
+    const char* fileNameWithExtension = GetImpl()->ProgramFileNameWithExtensionConst(context, program);
+    const char* moduleName = GetImpl()->ProgramModuleNameConst(context, program);
+    if (fileNameWithExtension == nullptr || moduleName == nullptr) {
+        return false;
+    }
+    size_t length = strlen(fileNameWithExtension);
+    return length >= MODULE_SUFFIX.length() &&
+           MODULE_SUFFIX.compare(fileNameWithExtension + length - MODULE_SUFFIX.length()) == 0 &&
+           strstr(moduleName, ARKUI.c_str()) != nullptr;
+}
 
-    return fileNameWithExtension.length() >= MODULE_SUFFIX.length() &&
-           fileNameWithExtension.substr(fileNameWithExtension.length() - MODULE_SUFFIX.length()) == MODULE_SUFFIX &&
-           moduleName.find(ARKUI) != std::string::npos;
+/*
+ * ProgramCanSkipPhases answers of one context. es2panda only lists external sources
+ * per importing program, so the reverse "depends on a UI header" map is kept per
+ * external source, keyed by its interned name: each source has its programs
+ * classified once, and a program's first query costs one lookup per source it
+ * imports instead of a walk over all their programs. Later queries are lookups.
+ */
+class SkipPhasesIndex {
+public:
+    bool CanSkipPhases(es2panda_Context* context, es2panda_Program* program)
+    {
+        uint8_t& flags = flagsOf[program];
+        if ((flags & DEPENDENCY_KNOWN) == 0) {
+            flags |= DEPENDENCY_KNOWN | (DependsOnUIHeader(context, program) ? DEPENDS_ON_UI_HEADER : 0);
+        }
+        return (flags & DEPENDS_ON_UI_HEADER) == 0;
+    }
+
+private:
+    enum Flags : uint8_t {
+        UI_HEADER_KNOWN = 1 << 0,
+        UI_HEADER = 1 << 1,
+        DEPENDENCY_KNOWN = 1 << 2,
+        DEPENDS_ON_UI_HEADER = 1 << 3,
+    };
+
+    bool IsUIHeader(es2panda_Context* context, es2panda_Program* program)
+    {
+        uint8_t& flags = flagsOf[program];
+        if ((flags & UI_HEADER_KNOWN) == 0) {
+            flags |= UI_HEADER_KNOWN | (isUIHeaderFile(context, program) ? UI_HEADER : 0);
+        }
+        return (flags & UI_HEADER) != 0;
+    }
+
+    bool SourceHasUIHeader(es2panda_Context* context, es2panda_ExternalSource* source)
+    {
+        const char* name = GetImpl()->ExternalSourceName(source);
+        const char* key = name != nullptr ? StringInterner::Instance()->Intern(name) : nullptr;
+        if (key != nullptr) {
+            auto it = sourceHasUIHeader.find(key);
+            if (it != sourceHasUIHeader.end()) {
+                return it->second;
+            }
+        }
+        bool result = false;
+        std::size_t programLen = 0;
+        auto programs = GetImpl()->ExternalSourcePrograms(source, &programLen);
+        for (std::size_t j = 0; programs != nullptr && j < programLen && !result; ++j) {
+            result = IsUIHeader(context, programs[j]);
+        }
+        if (key != nullptr) {
+            sourceHasUIHeader.emplace(key, result);
+        }
+        return result;
+    }
+
+    bool DependsOnUIHeader(es2panda_Context* context, es2panda_Program* program)
+    {
+        if (IsUIHeader(context, program)) {
+            return true;
+        }
+        std::size_t sourceLen = 0;
+        const auto externalSources = reinterpret_cast<es2panda_ExternalSource**>(
+            GetImpl()->ProgramExternalSources(context, program, &sourceLen));
+        for (std::size_t i = 0; externalSources != nullptr && i < sourceLen; ++i) {
+            if (SourceHasUIHeader(context, externalSources[i])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::unordered_map<const char*, bool> sourceHasUIHeader;
+    // References into this map stay valid across insertions, it is never erased from
+    std::unordered_map<es2panda_Program*, uint8_t> flagsOf;
+};
+
+static thread_local std::unordered_map<es2panda_Context*, SkipPhasesIndex> g_skipPhasesIndexes;
+
+static void ClearSkipPhasesIndexes()
+{
+    g_skipPhasesIndexes.clear();
 }
 
 KBoolean impl_ProgramCanSkipPhases(KNativePointer context, KNativePointer program)
 {
-    KStringPtr isUiFlag(IS_UI_FLAG);
-    KStringPtr notUiFlag(NOT_UI_FLAG);
     const auto _context = reinterpret_cast<es2panda_Context*>(context);
     const auto _program = reinterpret_cast<es2panda_Program*>(program);
-    if (isUIHeaderFile(_context, _program)) {
-        return false;
-    }
-    std::size_t sourceLen;
-    const auto externalSources =
-        reinterpret_cast<es2panda_ExternalSource**>(GetImpl()->ProgramExternalSources(_context, _program, &sourceLen));
-    for (std::size_t i = 0; i < sourceLen; ++i) {
-        std::size_t programLen;
-        auto programs = GetImpl()->ExternalSourcePrograms(externalSources[i], &programLen);
-        for (std::size_t j = 0; j < programLen; ++j) {
-            if (isUIHeaderFile(_context, programs[j])) {
-                return false;
-            }
-        }
-    }
-    return true;
+    return g_skipPhasesIndexes[_context].CanSkipPhases(_context, _program);
 }
 KOALA_INTEROP_2(ProgramCanSkipPhases, KBoolean, KNativePointer, KNativePointer)
 
+// ProgramCanSkipPhases of every program, 0 for null entries
+KInteropReturnBuffer impl_ProgramsCanSkipPhases(KNativePointer context, KNativePointerArray programs, KInt count)
+{
+    const auto _context = reinterpret_cast<es2panda_Context*>(context);
+    auto& index = g_skipPhasesIndexes[_context];
+    return MapPeers<int32_t>(programs, count, [&](es2panda_AstNode* program) {
+        return static_cast<int32_t>(index.CanSkipPhases(_context, reinterpret_cast<es2panda_Program*>(program)));
+    });
+}
+KOALA_INTEROP_3(ProgramsCanSkipPhases, KInteropReturnBuffer, KNativePointer, KNativePointerArray, KInt)
+
+// External sources are only collected while parsing, drop the answers when the state changes
+void impl_ProgramSkipPhasesRelease(KNativePointer context)
+{
+    g_skipPhasesIndexes.erase(reinterpret_cast<es2panda_Context*>(context));
+}
+KOALA_INTEROP_V1(ProgramSkipPhasesRelease, KNativePointer)
+
 KNativePointer impl_AstNodeProgram(KNativePointer contextPtr, KNativePointer instancePtr)
 {
     auto _context = reinterpret_cast<es2panda_Context*>(contextPtr);
     auto _receiver = reinterpret_cast<es2panda_AstNode*>(instancePtr);
 
-    if (GetImpl()->AstNodeIsProgramConst(_context, _receiver)) {
-        return GetImpl()->ETSModuleProgram(_context, _receiver);
-    }
-    auto parent = GetImpl()->AstNodeParent(_context, _receiver);
-    if (parent == nullptr) {
+    auto& index = AncestorIndexOf(_context);
+    auto* entry = index.Get(GetImpl(), _context, _receiver);
+    if (entry == nullptr || entry->program == nullptr) {
         return nullptr;
     }
-    return impl_AstNodeProgram(_context, parent);
+    return GetImpl()->ETSModuleProgram(_context, entry->program->node);
 }
 KOALA_INTEROP_2(AstNodeProgram, KNativePointer, KNativePointer, KNativePointer)
 
@@ -778,17 +2245,254 @@ void impl_MemoryTrackerPrintCurrent(KNativePointer context)
 {
     tracker.Report(GetMemoryStats());
 }
-KOALA_INTEROP_V1(MemoryTrackerPrintCurrent, KNativePointer);
-
-static KNativePointer findPropertyInClassDefinition(
-    KNativePointer context, KNativePointer classInstance, char *keyName);
-
-static KNativePointer findPropertyInTSInterfaceDeclaration(
-    KNativePointer context, KNativePointer classInstance, char *keyName);
-
-KNativePointer impl_ClassVariableDeclaration(KNativePointer context, KNativePointer classInstance);
+KOALA_INTEROP_V1(MemoryTrackerPrintCurrent, KNativePointer);
+
+static KNativePointer findPropertyInClassDefinition(
+    KNativePointer context, KNativePointer classInstance, char *keyName);
+
+static KNativePointer findPropertyInTSInterfaceDeclaration(
+    KNativePointer context, KNativePointer classInstance, char *keyName);
+
+KNativePointer impl_ClassVariableDeclaration(KNativePointer context, KNativePointer classInstance);
+KNativePointer impl_DeclarationFromMemberExpression(KNativePointer context, KNativePointer nodePtr);
+
+enum DeclarationQuery {
+    DECLARATION_FROM_AST_NODE,
+    DECLARATION_FROM_MEMBER_EXPRESSION,
+    DECLARATION_FROM_PROPERTY,
+    CLASS_VARIABLE_DECLARATION,
+    ANNOTATION_USAGE_DECLARATION,
+    DECLARATION_QUERY_COUNT,
+};
+
+// Properties of an annotation declaration and their positions by interned name
+struct AnnotationPropertyTable {
+    std::vector<es2panda_AstNode*> properties;
+    std::unordered_map<const char*, size_t> positions;
+};
+
+/*
+ * Resolved declarations of one context, keyed by the queried node. The TsType ->
+ * Variable -> Declaration chain only changes on Rebind/Recheck/ProceedToState.
+ * Rebind and Recheck invalidate the whole table from the TS side; the table also
+ * remembers the context state it was filled in and drops itself once the state
+ * changes, so direct ProceedToState calls are covered too. Null results are not
+ * cached, bindings may appear later in the same state. AstNodeOnUpdate drops the
+ * entries of the replaced and the new node, and all property lookups since they
+ * search the (possibly changed) class body by name; member list setters and
+ * splices drop the receiver and all property lookups as well. Annotation property tables
+ * are keyed by the declaration and dropped when it or one of its properties is
+ * updated.
+ */
+struct DeclarationCache {
+    std::unordered_map<es2panda_AstNode*, KNativePointer> entries[DECLARATION_QUERY_COUNT];
+    std::unordered_map<es2panda_AstNode*, AnnotationPropertyTable> annotationProperties;
+    es2panda_ContextState state {};
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    void Invalidate()
+    {
+        for (auto& table : entries) {
+            table.clear();
+        }
+        annotationProperties.clear();
+    }
+};
+
+static thread_local std::unordered_map<es2panda_Context*, DeclarationCache> g_declarationCaches;
+
+static DeclarationCache& DeclarationCacheOf(es2panda_Context* context)
+{
+    auto& cache = g_declarationCaches[context];
+    auto state = GetImpl()->ContextState(context);
+    if (cache.state != state) {
+        cache.Invalidate();
+        cache.state = state;
+    }
+    return cache;
+}
+
+template<typename Resolve>
+static KNativePointer CachedDeclaration(es2panda_Context* context, es2panda_AstNode* node, DeclarationQuery query,
+    Resolve&& resolve)
+{
+    auto& cache = DeclarationCacheOf(context);
+    auto it = cache.entries[query].find(node);
+    if (it != cache.entries[query].end()) {
+        cache.hits++;
+        return it->second;
+    }
+    cache.misses++;
+    KNativePointer result = resolve();
+    if (result != nullptr) {
+        cache.entries[query].emplace(node, result);
+    }
+    return result;
+}
+
+static void InvalidateUpdatedDeclarations(es2panda_Context* context, es2panda_AstNode* newNode,
+    es2panda_AstNode* replacedNode)
+{
+    auto it = g_declarationCaches.find(context);
+    if (it == g_declarationCaches.end()) {
+        return;
+    }
+    for (auto& table : it->second.entries) {
+        table.erase(newNode);
+        table.erase(replacedNode);
+    }
+    it->second.entries[DECLARATION_FROM_PROPERTY].clear();
+    auto& tables = it->second.annotationProperties;
+    if (!tables.empty()) {
+        tables.erase(newNode);
+        tables.erase(replacedNode);
+        if (newNode != nullptr) {
+            tables.erase(GetImpl()->AstNodeParent(context, newNode));
+        }
+    }
+}
+
+// Call after changing a member list of the receiver, property lookups search it by name
+static void InvalidateMutatedDeclarations(es2panda_Context* context, es2panda_AstNode* receiver)
+{
+    auto it = g_declarationCaches.find(context);
+    if (it == g_declarationCaches.end()) {
+        return;
+    }
+    for (auto& table : it->second.entries) {
+        table.erase(receiver);
+    }
+    it->second.entries[DECLARATION_FROM_PROPERTY].clear();
+    it->second.annotationProperties.erase(receiver);
+}
+
+static void ClearDeclarationCaches()
+{
+    g_declarationCaches.clear();
+}
+
+void impl_DeclarationCacheInvalidate(KNativePointer context)
+{
+    auto it = g_declarationCaches.find(reinterpret_cast<es2panda_Context*>(context));
+    if (it != g_declarationCaches.end()) {
+        it->second.Invalidate();
+    }
+}
+KOALA_INTEROP_V1(DeclarationCacheInvalidate, KNativePointer)
+
+void impl_DeclarationCacheRelease(KNativePointer context)
+{
+    g_declarationCaches.erase(reinterpret_cast<es2panda_Context*>(context));
+}
+KOALA_INTEROP_V1(DeclarationCacheRelease, KNativePointer)
+
+// [hits, misses, cached entries] of the context
+KInteropReturnBuffer impl_DeclarationCacheStats(KNativePointer context)
+{
+    auto* data = static_cast<uint64_t*>(calloc(3, sizeof(uint64_t)));
+    if (data == nullptr) {
+        return { 0, nullptr, nullptr, sizeof(uint64_t) };
+    }
+    auto it = g_declarationCaches.find(reinterpret_cast<es2panda_Context*>(context));
+    if (it != g_declarationCaches.end()) {
+        data[0] = it->second.hits;
+        data[1] = it->second.misses;
+        for (const auto& table : it->second.entries) {
+            data[2] += table.size();
+        }
+        data[2] += it->second.annotationProperties.size();
+    }
+    return { 3, data, DisposeMallocBuffer, sizeof(uint64_t) };
+}
+KOALA_INTEROP_1(DeclarationCacheStats, KInteropReturnBuffer, KNativePointer)
+
+static es2panda_AstNode* DoAnnotationUsageDeclaration(es2panda_Context* context, es2panda_AstNode* annotationUsage)
+{
+    auto* expr = GetImpl()->AnnotationUsageIrExpr(context, annotationUsage);
+    if (expr == nullptr || !GetImpl()->IsIdentifier(expr)) {
+        return nullptr;
+    }
+    auto* variable = GetImpl()->AstNodeVariableConst(context, expr);
+    if (variable == nullptr) {
+        return nullptr;
+    }
+    auto* decl = GetImpl()->VariableDeclaration(context, variable);
+    if (decl == nullptr) {
+        return nullptr;
+    }
+    return GetImpl()->DeclNode(context, decl);
+}
+
+static const char* InternedPropertyName(es2panda_Context* context, es2panda_AstNode* property, bool intern)
+{
+    auto* key = GetImpl()->ClassElementKey(context, property);
+    const char* name = key != nullptr ? GetImpl()->IdentifierName(context, key) : nullptr;
+    if (name == nullptr) {
+        return nullptr;
+    }
+    auto* interner = StringInterner::Instance();
+    return intern ? interner->Intern(name) : interner->Find(name, strlen(name));
+}
+
+static const AnnotationPropertyTable* GetAnnotationPropertyTable(es2panda_Context* context,
+    es2panda_AstNode* declNode)
+{
+    auto& tables = DeclarationCacheOf(context).annotationProperties;
+    auto it = tables.find(declNode);
+    if (it != tables.end()) {
+        return &it->second;
+    }
+    size_t declPropsLen = 0;
+    auto** declProps = GetImpl()->AnnotationDeclarationPropertiesConst(context, declNode, &declPropsLen);
+    if (declProps == nullptr) {
+        return nullptr;
+    }
+    AnnotationPropertyTable& table = tables[declNode];
+    table.properties.assign(declProps, declProps + declPropsLen);
+    table.positions.reserve(declPropsLen);
+    for (size_t i = 0; i < declPropsLen; i++) {
+        const char* name = InternedPropertyName(context, declProps[i], true);
+        if (name != nullptr) {
+            table.positions.emplace(name, i);
+        }
+    }
+    return &table;
+}
+
+// Usage properties replace the declaration properties with the same name, in declaration order
+static bool MergeAnnotationProperties(es2panda_Context* context, es2panda_AstNode* annotationUsage,
+    std::vector<es2panda_AstNode*>& merged)
+{
+    if (!GetImpl()->IsAnnotationUsage(annotationUsage)) {
+        return false;
+    }
+    auto* declNode = reinterpret_cast<es2panda_AstNode*>(CachedDeclaration(context, annotationUsage,
+        ANNOTATION_USAGE_DECLARATION, [&]() -> KNativePointer {
+            return DoAnnotationUsageDeclaration(context, annotationUsage);
+        }));
+    if (declNode == nullptr) {
+        return false;
+    }
+    const AnnotationPropertyTable* table = GetAnnotationPropertyTable(context, declNode);
+    if (table == nullptr) {
+        return false;
+    }
+    merged = table->properties;
+    size_t usagePropsLen = 0;
+    auto** usageProps = GetImpl()->AnnotationUsageIrPropertiesConst(context, annotationUsage, &usagePropsLen);
+    // Backwards, so the first usage property of a name wins
+    for (size_t i = usagePropsLen; i-- > 0;) {
+        const char* name = InternedPropertyName(context, usageProps[i], false);
+        auto position = name != nullptr ? table->positions.find(name) : table->positions.end();
+        if (position != table->positions.end()) {
+            merged[position->second] = usageProps[i];
+        }
+    }
+    return true;
+}
 
-KNativePointer impl_DeclarationFromProperty(KNativePointer context, KNativePointer property)
+static KNativePointer DoDeclarationFromProperty(KNativePointer context, KNativePointer property)
 {
     const auto _context = reinterpret_cast<es2panda_Context*>(context);
     const auto _property = reinterpret_cast<es2panda_AstNode*>(property);
@@ -816,9 +2520,16 @@ KNativePointer impl_DeclarationFromProperty(KNativePointer context, KNativePoint
     }
     return nullptr;
 }
+
+KNativePointer impl_DeclarationFromProperty(KNativePointer context, KNativePointer property)
+{
+    return CachedDeclaration(reinterpret_cast<es2panda_Context*>(context),
+        reinterpret_cast<es2panda_AstNode*>(property), DECLARATION_FROM_PROPERTY,
+        [&]() { return DoDeclarationFromProperty(context, property); });
+}
 KOALA_INTEROP_2(DeclarationFromProperty, KNativePointer, KNativePointer, KNativePointer);
 
-KNativePointer impl_DeclarationFromMemberExpression(KNativePointer context, KNativePointer nodePtr)
+static KNativePointer DoDeclarationFromMemberExpression(KNativePointer context, KNativePointer nodePtr)
 {
     const auto _context = reinterpret_cast<es2panda_Context*>(context);
     const auto _node = reinterpret_cast<es2panda_AstNode*>(nodePtr);
@@ -840,9 +2551,16 @@ KNativePointer impl_DeclarationFromMemberExpression(KNativePointer context, KNat
     }
     return GetImpl()->DeclarationFromIdentifier(_context, _propertyInstance);
 }
+
+KNativePointer impl_DeclarationFromMemberExpression(KNativePointer context, KNativePointer nodePtr)
+{
+    return CachedDeclaration(reinterpret_cast<es2panda_Context*>(context),
+        reinterpret_cast<es2panda_AstNode*>(nodePtr), DECLARATION_FROM_MEMBER_EXPRESSION,
+        [&]() { return DoDeclarationFromMemberExpression(context, nodePtr); });
+}
 KOALA_INTEROP_2(DeclarationFromMemberExpression, KNativePointer, KNativePointer, KNativePointer);
 
-KNativePointer impl_DeclarationFromAstNode(KNativePointer context, KNativePointer nodePtr)
+static KNativePointer DoDeclarationFromAstNode(KNativePointer context, KNativePointer nodePtr)
 {
     const auto _context = reinterpret_cast<es2panda_Context*>(context);
     const auto _node = reinterpret_cast<es2panda_AstNode*>(nodePtr);
@@ -857,9 +2575,16 @@ KNativePointer impl_DeclarationFromAstNode(KNativePointer context, KNativePointe
     }
     return GetImpl()->DeclarationFromIdentifier(_context, _node);
 }
+
+KNativePointer impl_DeclarationFromAstNode(KNativePointer context, KNativePointer nodePtr)
+{
+    return CachedDeclaration(reinterpret_cast<es2panda_Context*>(context),
+        reinterpret_cast<es2panda_AstNode*>(nodePtr), DECLARATION_FROM_AST_NODE,
+        [&]() { return DoDeclarationFromAstNode(context, nodePtr); });
+}
 KOALA_INTEROP_2(DeclarationFromAstNode, KNativePointer, KNativePointer, KNativePointer);
 
-KNativePointer impl_ClassVariableDeclaration(KNativePointer context, KNativePointer classInstance)
+static KNativePointer DoClassVariableDeclaration(KNativePointer context, KNativePointer classInstance)
 {
     const auto _context = reinterpret_cast<es2panda_Context*>(context);
     const auto _classInstance = reinterpret_cast<es2panda_AstNode*>(classInstance);
@@ -876,19 +2601,118 @@ KNativePointer impl_ClassVariableDeclaration(KNativePointer context, KNativePoin
     const auto declNode = GetImpl()->DeclNode(_context, result);
     return declNode;
 }
+
+KNativePointer impl_ClassVariableDeclaration(KNativePointer context, KNativePointer classInstance)
+{
+    return CachedDeclaration(reinterpret_cast<es2panda_Context*>(context),
+        reinterpret_cast<es2panda_AstNode*>(classInstance), CLASS_VARIABLE_DECLARATION,
+        [&]() { return DoClassVariableDeclaration(context, classInstance); });
+}
 KOALA_INTEROP_2(ClassVariableDeclaration, KNativePointer, KNativePointer, KNativePointer)
 
-thread_local KBoolean targetChildFound = false;
-thread_local es2panda_AstNode *targetInnerChild = nullptr;
-thread_local KInt targetAstNodeType = -1;
+enum AstSearchFlags {
+    AST_SEARCH_POST_ORDER = 1 << 0,
+    AST_SEARCH_INCLUDE_ROOT = 1 << 1,
+    AST_SEARCH_REVERSE_CHILDREN = 1 << 2, // post-order only
+};
+
+/*
+ * Collects up to limit (0 for no limit) nodes of the subtree whose type is in
+ * the mask (any type for a null mask), in pre-order or post-order, and stops as
+ * soon as the limit is reached. Post-order with reversed children visits nodes in
+ * reverse pre-order, so its first matches are the last pre-order ones. A non-negative maxDepth bounds the search, the
+ * children of the root have depth 1.
+ */
+static void SearchSubtree(es2panda_Context* context, es2panda_AstNode* root,
+    const std::bitset<AST_NODE_TYPE_LIMIT>* types, int maxDepth, KInt flags, size_t limit,
+    std::vector<es2panda_AstNode*>& result)
+{
+    es2panda_Impl* impl = GetImpl();
+    bool includeRoot = (flags & AST_SEARCH_INCLUDE_ROOT) != 0;
+    auto matches = [&](es2panda_AstNode* node, Es2pandaAstNodeType type, int depth) {
+        if ((depth != 0 || includeRoot) && (types == nullptr || (type < AST_NODE_TYPE_LIMIT && types->test(type)))) {
+            result.push_back(node);
+        }
+        return limit != 0 && result.size() >= limit;
+    };
+    if ((flags & AST_SEARCH_POST_ORDER) == 0) {
+        WalkSubtree(impl, context, root, maxDepth,
+            [&](es2panda_AstNode* node, Es2pandaAstNodeType type, Es2pandaAstNodeType, int depth) {
+                return matches(node, type, depth) ? WalkAction::STOP : WalkAction::CONTINUE;
+            });
+        return;
+    }
+    struct Entry {
+        es2panda_AstNode* node;
+        int depth;
+        bool expanded;
+    };
+    std::vector<Entry> stack;
+    stack.push_back({ root, 0, false });
+    while (!stack.empty()) {
+        auto current = stack.back();
+        stack.pop_back();
+        if (!current.expanded && (maxDepth < 0 || current.depth < maxDepth)) {
+            stack.push_back({ current.node, current.depth, true });
+            impl->AstNodeIterateConst(context, current.node, visitChild);
+            if ((flags & AST_SEARCH_REVERSE_CHILDREN) != 0) {
+                for (auto* child : cachedChildren) {
+                    stack.push_back({ child, current.depth + 1, false });
+                }
+            } else {
+                for (auto it = cachedChildren.rbegin(); it != cachedChildren.rend(); ++it) {
+                    stack.push_back({ *it, current.depth + 1, false });
+                }
+            }
+            cachedChildren.clear();
+            continue;
+        }
+        if (matches(current.node, impl->AstNodeTypeConst(context, current.node), current.depth)) {
+            return;
+        }
+    }
+}
 
-static void findNodeInnerChild(es2panda_AstNode *node)
+static bool FillTypesMask(std::bitset<AST_NODE_TYPE_LIMIT>& mask, const KInt* types, KInt typesCount)
 {
-    if (targetInnerChild == node) {
-        targetChildFound = true;
+    if (types == nullptr || typesCount <= 0) {
+        return false;
+    }
+    for (KInt i = 0; i < typesCount; i++) {
+        if (types[i] >= 0 && types[i] < AST_NODE_TYPE_LIMIT) {
+            mask.set(types[i]);
+        }
     }
+    return true;
+}
+
+// First node of one of the types (any type if none given), see SearchSubtree
+KNativePointer impl_AstNodeFindFirst(KNativePointer context, KNativePointer root, KInt* types, KInt typesCount,
+    KInt maxDepth, KInt flags)
+{
+    std::bitset<AST_NODE_TYPE_LIMIT> mask;
+    bool filtered = FillTypesMask(mask, types, typesCount);
+    std::vector<es2panda_AstNode*> result;
+    SearchSubtree(reinterpret_cast<es2panda_Context*>(context), reinterpret_cast<es2panda_AstNode*>(root),
+        filtered ? &mask : nullptr, maxDepth, flags, 1, result);
+    return result.empty() ? nullptr : result.front();
 }
+KOALA_INTEROP_6(AstNodeFindFirst, KNativePointer, KNativePointer, KNativePointer, KInt*, KInt, KInt, KInt)
 
+// First limit nodes (all for 0) of one of the types, see SearchSubtree
+KNativePointer impl_AstNodeFindFirstN(KNativePointer context, KNativePointer root, KInt* types, KInt typesCount,
+    KInt maxDepth, KInt flags, KInt limit)
+{
+    std::bitset<AST_NODE_TYPE_LIMIT> mask;
+    bool filtered = FillTypesMask(mask, types, typesCount);
+    std::vector<es2panda_AstNode*> result;
+    SearchSubtree(reinterpret_cast<es2panda_Context*>(context), reinterpret_cast<es2panda_AstNode*>(root),
+        filtered ? &mask : nullptr, maxDepth, flags, limit > 0 ? static_cast<size_t>(limit) : 0, result);
+    return StageArena::CloneVector(result.data(), result.size());
+}
+KOALA_INTEROP_7(AstNodeFindFirstN, KNativePointer, KNativePointer, KNativePointer, KInt*, KInt, KInt, KInt, KInt)
+
+// Whether the target is a direct child of the node
 KBoolean impl_AstNodeFindNodeInInnerChild(
     KNativePointer contextPtr, KNativePointer instancePtr, KNativePointer tartgetPtr)
 {
@@ -898,29 +2722,31 @@ KBoolean impl_AstNodeFindNodeInInnerChild(
     auto _context = reinterpret_cast<es2panda_Context*>(contextPtr);
     auto _receiver = reinterpret_cast<es2panda_AstNode*>(instancePtr);
     auto _target = reinterpret_cast<es2panda_AstNode*>(tartgetPtr);
-    targetChildFound = false;
-    targetInnerChild = _target;
-    GetImpl()->AstNodeIterateConst(_context, _receiver, findNodeInnerChild);
-    return targetChildFound;
+    cachedChildren.clear();
+    GetImpl()->AstNodeIterateConst(_context, _receiver, visitChild);
+    bool found = std::find(cachedChildren.begin(), cachedChildren.end(), _target) != cachedChildren.end();
+    cachedChildren.clear();
+    return found;
 }
 KOALA_INTEROP_3(AstNodeFindNodeInInnerChild, KBoolean, KNativePointer, KNativePointer, KNativePointer);
 
-static void findInnerChild(es2panda_AstNode *node, void *arg)
-{
-    auto *context = static_cast<es2panda_Context *>(arg);
-    if (targetAstNodeType == GetImpl()->AstNodeTypeConst(context, node)) {
-        targetInnerChild = node;
-    }
-}
-
+/*
+ * Last node of the type in pre-order, the node itself included, as AstNodeForEach
+ * would leave it. Walks in reverse pre-order, so it still stops at the first match.
+ */
 KNativePointer impl_AstNodeFindInnerChild(KNativePointer contextPtr, KNativePointer instancePtr, KInt AstNodeType)
 {
     auto _context = reinterpret_cast<es2panda_Context*>(contextPtr);
     auto _receiver = reinterpret_cast<es2panda_AstNode*>(instancePtr);
-    targetAstNodeType = AstNodeType;
-
-    GetImpl()->AstNodeForEach(_receiver, findInnerChild, _context);
-    return targetInnerChild;
+    if (AstNodeType < 0 || AstNodeType >= AST_NODE_TYPE_LIMIT) {
+        return nullptr;
+    }
+    std::bitset<AST_NODE_TYPE_LIMIT> mask;
+    mask.set(AstNodeType);
+    std::vector<es2panda_AstNode*> result;
+    SearchSubtree(_context, _receiver, &mask, -1,
+        AST_SEARCH_POST_ORDER | AST_SEARCH_INCLUDE_ROOT | AST_SEARCH_REVERSE_CHILDREN, 1, result);
+    return result.empty() ? nullptr : result.front();
 }
 KOALA_INTEROP_3(AstNodeFindInnerChild, KNativePointer, KNativePointer, KNativePointer, KInt);
 
@@ -928,19 +2754,59 @@ KNativePointer impl_AstNodeFindOuterParent(KNativePointer contextPtr, KNativePoi
 {
     auto _context = reinterpret_cast<es2panda_Context*>(contextPtr);
     auto _receiver = reinterpret_cast<es2panda_AstNode*>(instancePtr);
-    if (GetImpl()->AstNodeIsProgramConst(_context, _receiver)) {
-        return nullptr;
-    }
-    if (AstNodeType == GetImpl()->AstNodeTypeConst(_context, _receiver)) {
-        return _receiver;
+    auto& index = AncestorIndexOf(_context);
+    // Stops at the program node, as the outer parent search never leaves the program
+    for (auto* entry = index.Get(GetImpl(), _context, _receiver); entry != nullptr; entry = entry->parent) {
+        if (entry->program == entry) {
+            return nullptr;
+        }
+        if (AstNodeType == entry->type) {
+            return entry->node;
+        }
     }
-    auto parent = GetImpl()->AstNodeParent(_context, _receiver);
-    if (parent == nullptr) {
+    return nullptr;
+}
+KOALA_INTEROP_3(AstNodeFindOuterParent, KNativePointer, KNativePointer, KNativePointer, KInt);
+
+// Lowest common ancestor-or-self of the nodes, null if they are in different trees
+KNativePointer impl_AstNodeCommonAncestor(KNativePointer contextPtr, KNativePointer firstPtr, KNativePointer secondPtr)
+{
+    auto _context = reinterpret_cast<es2panda_Context*>(contextPtr);
+    auto* _first = reinterpret_cast<es2panda_AstNode*>(firstPtr);
+    auto* _second = reinterpret_cast<es2panda_AstNode*>(secondPtr);
+    auto& index = AncestorIndexOf(_context);
+    auto* first = index.Get(GetImpl(), _context, _first);
+    auto* second = index.Get(GetImpl(), _context, _second);
+    if (first == nullptr || second == nullptr) {
         return nullptr;
     }
-    return impl_AstNodeFindOuterParent(_context, parent, AstNodeType);
+    auto* ancestor = AncestorIndex::CommonAncestor(first, second);
+    return ancestor ? ancestor->node : nullptr;
 }
-KOALA_INTEROP_3(AstNodeFindOuterParent, KNativePointer, KNativePointer, KNativePointer, KInt);
+KOALA_INTEROP_3(AstNodeCommonAncestor, KNativePointer, KNativePointer, KNativePointer, KNativePointer)
+
+// Whether the node is the ancestor or one of its descendants
+KBoolean impl_AstNodeIsInside(KNativePointer contextPtr, KNativePointer nodePtr, KNativePointer ancestorPtr)
+{
+    auto _context = reinterpret_cast<es2panda_Context*>(contextPtr);
+    auto* _node = reinterpret_cast<es2panda_AstNode*>(nodePtr);
+    auto* _ancestor = reinterpret_cast<es2panda_AstNode*>(ancestorPtr);
+    auto& index = AncestorIndexOf(_context);
+    auto* node = index.Get(GetImpl(), _context, _node);
+    auto* ancestor = index.Get(GetImpl(), _context, _ancestor);
+    if (node == nullptr || ancestor == nullptr || node->depth < ancestor->depth) {
+        return false;
+    }
+    return AncestorIndex::Lift(node, ancestor->depth) == ancestor;
+}
+KOALA_INTEROP_3(AstNodeIsInside, KBoolean, KNativePointer, KNativePointer, KNativePointer)
+
+// Parents set by other bridges than the repair ones are not seen by the index, drop it after them
+void impl_AncestorIndexRelease(KNativePointer context)
+{
+    ReleaseAncestorIndex(reinterpret_cast<es2panda_Context*>(context));
+}
+KOALA_INTEROP_V1(AncestorIndexRelease, KNativePointer)
 
 /*
 ------------------------------------------------------------------------------------------------------------------------
@@ -1798,6 +3664,283 @@ struct TSInterfaceDeclarationResolver {
     }
 };
 
+static es2panda_AstNode* GetSuperClassDeclaration(es2panda_Impl* impl, es2panda_Context* context,
+    es2panda_AstNode* classDefinition);
+
+// Helper: Get the identifier naming an ETSTypeReference, nullptr if it is not a plain identifier
+static es2panda_AstNode* GetTypeReferenceIdentifier(es2panda_Impl* impl, es2panda_Context* context,
+    es2panda_AstNode* typeReference)
+{
+    if (typeReference == nullptr || !impl->IsETSTypeReference(typeReference)) {
+        return nullptr;
+    }
+    auto* part = impl->ETSTypeReferencePart(context, typeReference);
+    if (part == nullptr) {
+        return nullptr;
+    }
+    auto* name = impl->ETSTypeReferencePartName(context, part);
+    return (name != nullptr && impl->IsIdentifier(name)) ? name : nullptr;
+}
+
+// Helper: Resolve an ETSTypeReference to the interface it names
+static es2panda_AstNode* GetInterfaceDeclaration(es2panda_Impl* impl, es2panda_Context* context,
+    es2panda_AstNode* typeReference)
+{
+    auto* name = GetTypeReferenceIdentifier(impl, context, typeReference);
+    if (name == nullptr) {
+        return nullptr;
+    }
+    auto* declaration = impl->DeclarationFromIdentifier(context, name);
+    return (declaration != nullptr && impl->IsTSInterfaceDeclaration(declaration)) ? declaration : nullptr;
+}
+
+struct ClassHierarchyEntry {
+    // Same members as ClassDefinitionResolver / TSInterfaceDeclarationResolver collect
+    std::vector<es2panda_AstNode*> properties;
+    // What a subclass inherits: like properties, but an ancestor wins over a descendant
+    // (ClassDefinitionResolver::CollectPropertiesFrom)
+    std::vector<es2panda_AstNode*> inherited;
+    // Interned property name -> property, inherited ones included
+    std::unordered_map<const char*, es2panda_AstNode*> members;
+    // Interned class name -> nearest "extends" ETSTypeReference with that name
+    std::unordered_map<const char*, es2panda_AstNode*> superReferences;
+    // Transitive super classes and interfaces
+    std::unordered_set<es2panda_AstNode*> supertypes;
+};
+
+/*
+ * Class and interface hierarchy of one context. Entries are built on first use
+ * and reuse the entries of their supertypes. Invalidating a declaration drops its
+ * entry together with the entries of every indexed subtype.
+ */
+class ClassHierarchyIndex {
+public:
+    const ClassHierarchyEntry& Get(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* declaration)
+    {
+        auto [it, inserted] = entries.try_emplace(declaration);
+        // An entry that is still being built is returned as is, this cuts inheritance cycles
+        if (inserted) {
+            Build(impl, context, declaration, it->second);
+        }
+        return it->second;
+    }
+
+    void Invalidate(es2panda_AstNode* declaration)
+    {
+        std::vector<es2panda_AstNode*> stack { declaration };
+        while (!stack.empty()) {
+            auto* current = stack.back();
+            stack.pop_back();
+            entries.erase(current);
+            auto it = subtypes.find(current);
+            if (it != subtypes.end()) {
+                stack.insert(stack.end(), it->second.begin(), it->second.end());
+                subtypes.erase(it);
+            }
+        }
+    }
+
+    void Clear()
+    {
+        entries.clear();
+        subtypes.clear();
+    }
+
+private:
+    void AddSupertype(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* declaration,
+        ClassHierarchyEntry& entry, es2panda_AstNode* supertype)
+    {
+        if (supertype == nullptr || supertype == declaration) {
+            return;
+        }
+        subtypes[supertype].push_back(declaration);
+        entry.supertypes.insert(supertype);
+        const auto& inherited = Get(impl, context, supertype);
+        entry.supertypes.insert(inherited.supertypes.begin(), inherited.supertypes.end());
+    }
+
+    // Only the own body is read, inherited members come from the super class entry
+    void CollectClassProperties(es2panda_Context* context, es2panda_AstNode* declaration, ClassHierarchyEntry& entry,
+        const ClassHierarchyEntry* superEntry)
+    {
+        ClassDefinitionResolver bodyResolver(context, nullptr);
+        auto* interner = StringInterner::Instance();
+        auto nameOf = [&](es2panda_AstNode* member) {
+            const char* name = bodyResolver.GetPropertyName(member);
+            return name ? interner->Intern(name) : nullptr;
+        };
+        std::unordered_set<const char*> inheritedNames;
+        if (superEntry != nullptr) {
+            entry.inherited = superEntry->inherited;
+            for (auto* member : entry.inherited) {
+                inheritedNames.insert(nameOf(member));
+            }
+        }
+        auto body = bodyResolver.CollectPropertiesFromClassBody(declaration);
+        std::unordered_set<const char*> overridden;
+        for (auto* member : body) {
+            const char* name = nameOf(member);
+            if (name == nullptr) {
+                continue;
+            }
+            if (inheritedNames.count(name) > 0) {
+                overridden.insert(name);
+            } else {
+                entry.inherited.push_back(member);
+            }
+        }
+        for (size_t i = 0; superEntry != nullptr && i < superEntry->inherited.size(); i++) {
+            if (overridden.count(nameOf(superEntry->inherited[i])) == 0) {
+                entry.properties.push_back(superEntry->inherited[i]);
+            }
+        }
+        for (auto* member : body) {
+            if (nameOf(member) != nullptr) {
+                entry.properties.push_back(member);
+            }
+        }
+    }
+
+    void Build(es2panda_Impl* impl, es2panda_Context* context, es2panda_AstNode* declaration,
+        ClassHierarchyEntry& entry)
+    {
+        auto* interner = StringInterner::Instance();
+        if (impl->IsClassDefinition(declaration)) {
+            auto* superClass = impl->ClassDefinitionSuper(context, declaration);
+            auto* superName = GetTypeReferenceIdentifier(impl, context, superClass);
+            const char* superClassName = superName ? impl->IdentifierNameConst(context, superName) : nullptr;
+            if (superClassName != nullptr) {
+                entry.superReferences.emplace(interner->Intern(superClassName), superClass);
+            }
+            auto* superDecl = GetSuperClassDeclaration(impl, context, declaration);
+            AddSupertype(impl, context, declaration, entry, superDecl);
+            const ClassHierarchyEntry* superEntry = nullptr;
+            if (superDecl != nullptr && superDecl != declaration) {
+                superEntry = &Get(impl, context, superDecl);
+                entry.superReferences.insert(superEntry->superReferences.begin(), superEntry->superReferences.end());
+            }
+            CollectClassProperties(context, declaration, entry, superEntry);
+            size_t implementsLength = 0;
+            auto** implements = impl->ClassDefinitionImplements(context, declaration, &implementsLength);
+            for (size_t i = 0; implements != nullptr && i < implementsLength; i++) {
+                auto* expr = implements[i] ? impl->TSClassImplementsExpr(context, implements[i]) : nullptr;
+                AddSupertype(impl, context, declaration, entry, GetInterfaceDeclaration(impl, context, expr));
+            }
+        } else if (impl->IsTSInterfaceDeclaration(declaration)) {
+            entry.properties = TSInterfaceDeclarationResolver(context, declaration).GetProperties();
+            size_t extendsLength = 0;
+            auto** extends = impl->TSInterfaceDeclarationExtends(context, declaration, &extendsLength);
+            for (size_t i = 0; extends != nullptr && i < extendsLength; i++) {
+                auto* expr = (extends[i] && impl->IsTSInterfaceHeritage(extends[i]))
+                    ? impl->TSInterfaceHeritageExpr(context, extends[i]) : nullptr;
+                AddSupertype(impl, context, declaration, entry, GetInterfaceDeclaration(impl, context, expr));
+            }
+        }
+        for (auto* member : entry.properties) {
+            auto* key = member ? impl->ClassElementKey(context, member) : nullptr;
+            const char* name = key ? impl->IdentifierNameConst(context, key) : nullptr;
+            if (name != nullptr) {
+                entry.members.emplace(interner->Intern(name), member);
+            }
+        }
+    }
+
+    std::unordered_map<es2panda_AstNode*, ClassHierarchyEntry> entries;
+    // Direct supertype -> indexed subtypes, used for invalidation
+    std::unordered_map<es2panda_AstNode*, std::vector<es2panda_AstNode*>> subtypes;
+};
+
+static thread_local std::unordered_map<es2panda_Context*, ClassHierarchyIndex> g_classHierarchies;
+
+static const ClassHierarchyEntry& GetClassHierarchyEntry(es2panda_Context* context, es2panda_AstNode* declaration)
+{
+    return g_classHierarchies[context].Get(GetImpl(), context, declaration);
+}
+
+static es2panda_AstNode* FindClassHierarchyMember(es2panda_Context* context, es2panda_AstNode* declaration,
+    const char* name)
+{
+    // Building the entry interns every member name, so an unknown name cannot match
+    const auto& members = GetClassHierarchyEntry(context, declaration).members;
+    const char* key = name ? StringInterner::Instance()->Find(name, strlen(name)) : nullptr;
+    auto it = members.find(key);
+    return it != members.end() ? it->second : nullptr;
+}
+
+static void InvalidateClassHierarchy(es2panda_Context* context, es2panda_AstNode* declaration)
+{
+    auto it = g_classHierarchies.find(context);
+    if (it != g_classHierarchies.end()) {
+        it->second.Invalidate(declaration);
+    }
+}
+
+constexpr int CLASS_MEMBER_NESTING = 3;
+
+// A changed member, its key or an interface body changes the nearest enclosing declaration
+static void InvalidateUpdatedClassHierarchy(es2panda_Context* context, es2panda_AstNode* newNode,
+    es2panda_AstNode* replacedNode)
+{
+    auto it = g_classHierarchies.find(context);
+    if (it == g_classHierarchies.end()) {
+        return;
+    }
+    es2panda_Impl* impl = GetImpl();
+    for (auto* node : { replacedNode, newNode }) {
+        for (int level = 0; node != nullptr && level <= CLASS_MEMBER_NESTING; level++) {
+            if (impl->IsClassDefinition(node) || impl->IsTSInterfaceDeclaration(node)) {
+                it->second.Invalidate(node);
+                break;
+            }
+            node = impl->AstNodeParent(context, node);
+        }
+    }
+}
+
+static void ClearClassHierarchies()
+{
+    g_classHierarchies.clear();
+}
+
+void impl_ClassHierarchyInvalidate(KNativePointer context)
+{
+    auto it = g_classHierarchies.find(reinterpret_cast<es2panda_Context*>(context));
+    if (it != g_classHierarchies.end()) {
+        it->second.Clear();
+    }
+}
+KOALA_INTEROP_V1(ClassHierarchyInvalidate, KNativePointer)
+
+void impl_ClassHierarchyRelease(KNativePointer context)
+{
+    g_classHierarchies.erase(reinterpret_cast<es2panda_Context*>(context));
+}
+KOALA_INTEROP_V1(ClassHierarchyRelease, KNativePointer)
+
+KNativePointer impl_ClassHierarchyFindProperty(KNativePointer context, KNativePointer declaration,
+    const KStringPtr& name)
+{
+    auto* _context = reinterpret_cast<es2panda_Context*>(context);
+    auto* _declaration = reinterpret_cast<es2panda_AstNode*>(declaration);
+    if (_context == nullptr || _declaration == nullptr) {
+        return nullptr;
+    }
+    return FindClassHierarchyMember(_context, _declaration, name.c_str());
+}
+KOALA_INTEROP_3(ClassHierarchyFindProperty, KNativePointer, KNativePointer, KNativePointer, KStringPtr)
+
+KBoolean impl_ClassHierarchyIsSubtype(KNativePointer context, KNativePointer declaration, KNativePointer base)
+{
+    auto* _context = reinterpret_cast<es2panda_Context*>(context);
+    auto* _declaration = reinterpret_cast<es2panda_AstNode*>(declaration);
+    auto* _base = reinterpret_cast<es2panda_AstNode*>(base);
+    if (_context == nullptr || _declaration == nullptr || _base == nullptr) {
+        return false;
+    }
+    return _declaration == _base || GetClassHierarchyEntry(_context, _declaration).supertypes.count(_base) > 0;
+}
+KOALA_INTEROP_3(ClassHierarchyIsSubtype, KBoolean, KNativePointer, KNativePointer, KNativePointer)
+
 /**
  * Resolves element type from array type node (supports T[] and Array<T> syntax).
  * Unwraps type aliases and union types.
@@ -2045,16 +4188,7 @@ KNativePointer impl_ResolveClassDefinitionProperties(KNativePointer contextPtr,
         return StageArena::CloneVector(static_cast<es2panda_AstNode**>(nullptr), 0);
     }
 
-    // Use ClassDefinitionResolver struct for safe property collection
-    ClassDefinitionResolver classResolver(_context, _classDef);
-
-    // Double-check the struct is valid after construction (defensive programming)
-    if (!classResolver.IsValid()) {
-        return StageArena::CloneVector(static_cast<es2panda_AstNode**>(nullptr), 0);
-    }
-
-    // Get collected properties using accessor method
-    const auto& properties = classResolver.GetProperties();
+    const auto& properties = GetClassHierarchyEntry(_context, _classDef).properties;
 
     // Convert to format suitable for return to TypeScript
     return StageArena::CloneVector(properties.data(), properties.size());
@@ -2077,15 +4211,7 @@ KNativePointer impl_ResolveTSInterfaceDeclarationProperties(KNativePointer conte
         return StageArena::CloneVector(static_cast<es2panda_AstNode**>(nullptr), 0);
     }
 
-    // Use TSInterfaceDeclarationResolver struct for safe property collection
-    TSInterfaceDeclarationResolver interfaceResolver(_context, _interfaceDecl);
-
-    if (!interfaceResolver.IsValid()) {
-        return StageArena::CloneVector(static_cast<es2panda_AstNode**>(nullptr), 0);
-    }
-
-    // Get collected properties using accessor method
-    const auto& properties = interfaceResolver.GetProperties();
+    const auto& properties = GetClassHierarchyEntry(_context, _interfaceDecl).properties;
 
     // Convert to format suitable for return to TypeScript
     return StageArena::CloneVector(properties.data(), properties.size());
@@ -2148,30 +4274,6 @@ KNativePointer impl_ResolveArrayLikeType(KNativePointer contextPtr, KNativePoint
 }
 KOALA_INTEROP_2(ResolveArrayLikeType, KNativePointer, KNativePointer, KNativePointer);
 
-// Helper: Check if an ETSTypeReference's name matches the given target name
-static bool TypeReferenceNameEquals(es2panda_Impl* impl,
-    es2panda_Context* context,
-    es2panda_AstNode* typeReference,
-    const char* targetName)
-{
-    if (impl == nullptr || context == nullptr || typeReference == nullptr || targetName == nullptr) {
-        return false;
-    }
-    auto* part = impl->ETSTypeReferencePart(context, typeReference);
-    if (part == nullptr) {
-        return false;
-    }
-    auto* name = impl->ETSTypeReferencePartName(context, part);
-    if (name == nullptr || !impl->IsIdentifier(name)) {
-        return false;
-    }
-    const char* nameStr = impl->IdentifierNameConst(context, name);
-    if (nameStr == nullptr) {
-        return false;
-    }
-    return strcmp(nameStr, targetName) == 0;
-}
-
 // Helper: Get the super class declaration from a class definition (standalone version)
 static es2panda_AstNode* GetSuperClassDeclaration(es2panda_Impl* impl,
     es2panda_Context* context,
@@ -2223,31 +4325,11 @@ KNativePointer impl_ClassDefinitionFindSuperClassByName(KNativePointer contextPt
     if (!impl->IsClassDefinition(_classDef)) {
         return nullptr;
     }
-    const auto targetName = getStringCopy(baseClassName);
-    // Start with the current class
-    es2panda_AstNode* currentClass = _classDef;
-    std::unordered_set<es2panda_AstNode*> visited;  // Prevent infinite loops for circular inheritance
-    while (currentClass != nullptr && visited.find(currentClass) == visited.end()) {
-        visited.insert(currentClass);
-        // Get superClass (parent class) - this is the "extends" clause
-        auto* superClass = impl->ClassDefinitionSuper(_context, currentClass);
-        if (superClass == nullptr || !impl->IsETSTypeReference(superClass)) {
-            break;
-        }
-        // Check if superClass name matches target
-        if (TypeReferenceNameEquals(impl, _context, superClass, targetName)) {
-            // Found! Return superClass expression (ETSTypeReference)
-            return superClass;
-        }
-        // Get super class declaration and continue traversal
-        auto* superDecl = GetSuperClassDeclaration(impl, _context, currentClass);
-        if (superDecl == nullptr) {
-            break;
-        }
-        // Continue with parent class
-        currentClass = superDecl;
-    }
-    return nullptr;
+    // Building the entry interns every super class name, so an unknown name cannot match
+    const auto& superReferences = GetClassHierarchyEntry(_context, _classDef).superReferences;
+    const char* targetName = StringInterner::Instance()->Find(baseClassName.c_str(), baseClassName.length());
+    auto it = superReferences.find(targetName);
+    return it != superReferences.end() ? it->second : nullptr;
 }
 KOALA_INTEROP_3(ClassDefinitionFindSuperClassByName, KNativePointer, KNativePointer, KNativePointer, KStringPtr);
 
@@ -2255,30 +4337,7 @@ static KNativePointer findPropertyInClassDefinition(KNativePointer context, KNat
 {
     const auto _context = reinterpret_cast<es2panda_Context*>(context);
     const auto _instance = reinterpret_cast<es2panda_AstNode*>(classInstance);
-
-    // Use ClassDefinitionResolver struct for safe property collection
-    ClassDefinitionResolver classResolver(_context, _instance);
-
-    // Double-check the struct is valid after construction (defensive programming)
-    if (!classResolver.IsValid()) {
-        return nullptr;
-    }
-
-    // Get collected properties using accessor method
-    const auto& properties = classResolver.GetProperties();
-    for (auto* member : properties) {
-        if (member == nullptr) {
-            continue;
-        }
-        const auto _key = reinterpret_cast<es2panda_AstNode*>(GetImpl()->ClassElementKey(_context, member));
-        if (_key == nullptr) {
-            continue;
-        }
-        if (strcmp(GetImpl()->IdentifierName(_context, _key), keyName) == 0) {
-            return member;
-        }
-    }
-    return nullptr;
+    return FindClassHierarchyMember(_context, _instance, keyName);
 }
 
 static KNativePointer findPropertyInTSInterfaceDeclaration(
@@ -2286,27 +4345,5 @@ static KNativePointer findPropertyInTSInterfaceDeclaration(
 {
     const auto _context = reinterpret_cast<es2panda_Context*>(context);
     const auto _instance = reinterpret_cast<es2panda_AstNode*>(classInstance);
-
-    // Use TSInterfaceDeclarationResolver struct for safe property collection
-    TSInterfaceDeclarationResolver interfaceResolver(_context, _instance);
-
-    if (!interfaceResolver.IsValid()) {
-        return nullptr;
-    }
-
-    // Get collected properties using accessor method
-    const auto& properties = interfaceResolver.GetProperties();
-    for (auto* member : properties) {
-        if (member == nullptr) {
-            continue;
-        }
-        const auto _key = reinterpret_cast<es2panda_AstNode*>(GetImpl()->ClassElementKey(_context, member));
-        if (_key == nullptr) {
-            continue;
-        }
-        if (strcmp(GetImpl()->IdentifierName(_context, _key), keyName) == 0) {
-            return member;
-        }
-    }
-    return nullptr;
+    return FindClassHierarchyMember(_context, _instance, keyName);
 }
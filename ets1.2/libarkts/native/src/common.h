@@ -16,8 +16,12 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "common-interop.h"
@@ -43,6 +47,10 @@ string getString(KStringPtr ptr);
 const char** getStringArray(KStringArray& ptr);
 
 char* getStringCopy(KStringPtr& ptr);
+// Stable until DestroyConfig, equal strings share the same address.
+const char* getInternedString(const KStringPtr& ptr);
+// Dispose callback of KInteropReturnBuffer data allocated with malloc.
+void DisposeMallocBuffer(KNativePointer data, KInt length);
 
 inline KUInt unpackUInt(const KByte* bytes)
 {
@@ -60,11 +68,130 @@ inline KUInt unpackUInt(const KByte* bytes)
 
 es2panda_ContextState intToState(KInt state);
 
+// FNV-1a, used for interned strings and name keyed tables.
+inline uint64_t HashString(const char* data, size_t length)
+{
+    const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+    const uint64_t FNV_PRIME = 1099511628211ULL;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/*
+ * Table of unique strings with stable addresses, so equal interned strings
+ * can be compared by pointer. Payloads live in own slabs, independent of
+ * StageArena scopes, and are released by Clear() together with the config.
+ */
+class StringInterner {
+    struct Entry {
+        const char* data;
+        uint64_t hash;
+        size_t length;
+    };
+    std::vector<Entry> table;
+    std::vector<char*> slabs;
+    char* current;
+    char* end;
+    size_t count;
+
+    const Entry* Lookup(const char* data, size_t length, uint64_t hash) const;
+    char* Store(const char* data, size_t length);
+    void Grow();
+
+public:
+    static constexpr size_t SLAB_SIZE = 1 << 16;
+
+    StringInterner();
+    ~StringInterner();
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+    static StringInterner* Instance();
+
+    const char* Intern(const char* data, size_t length);
+    const char* Intern(const char* data)
+    {
+        return Intern(data, strlen(data));
+    }
+    // Returns the interned copy if present, never allocates.
+    const char* Find(const char* data, size_t length) const;
+    size_t Size() const
+    {
+        return count;
+    }
+    void Clear();
+};
+
 class StageArena {
-    std::vector<void*> allocated;
+    // Slabs are chained through this header, newest first; payload follows the header.
+    struct Chunk {
+        Chunk* prev;
+        size_t size;
+    };
+    // Destructors of non-trivial objects placed in the arena, run on Cleanup in reverse order.
+    struct Finalizer {
+        Finalizer* next;
+        void (*destroy)(void*);
+        void* object;
+    };
+    Chunk* chunks;
+    // Dedicated slabs for oversized requests, kept apart so the current slab stays in use.
+    Chunk* large;
+    // Payloads es2panda may keep, e.g. string copies; released by Cleanup() only, never by scopes.
+    Chunk* pinned;
+    Finalizer* finalizers;
+    char* current;
+    char* end;
+    size_t chunkSize;
     size_t totalSize;
 
+    void* AllocSlow(size_t size, size_t align);
+    void* AllocPinned(size_t size);
+    static size_t ChunkHeaderSize();
+    template<typename T>
+    static T* Track(T* object)
+    {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            auto* arena = StageArena::Instance();
+            auto* finalizer = static_cast<Finalizer*>(arena->Alloc(sizeof(Finalizer), alignof(Finalizer)));
+            finalizer->next = arena->finalizers;
+            finalizer->destroy = [](void* pointer) { static_cast<T*>(pointer)->~T(); };
+            finalizer->object = object;
+            arena->finalizers = finalizer;
+        }
+        return object;
+    }
+
 public:
+    // Allocation state captured by Mark(), everything allocated after it is released by Rollback().
+    struct Checkpoint {
+        Chunk* chunks;
+        Chunk* large;
+        Finalizer* finalizers;
+        char* current;
+        char* end;
+        size_t totalSize;
+    };
+    // Releases the arena memory allocated during the lifetime of the scope.
+    class Scope {
+    public:
+        Scope() : checkpoint(StageArena::Instance()->Mark()) {}
+        ~Scope()
+        {
+            StageArena::Instance()->Rollback(checkpoint);
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Checkpoint checkpoint;
+    };
+
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+    static constexpr size_t MIN_CHUNK_SIZE = 1 << 12;
+
     StageArena();
     ~StageArena();
     static StageArena* Instance();
@@ -72,47 +199,89 @@ public:
     static T* Alloc()
     {
         auto* arena = StageArena::Instance();
-        void* memory = arena->Alloc(sizeof(T));
-        return new (memory) T();
+        void* memory = arena->Alloc(sizeof(T), alignof(T));
+        return Track(new (memory) T());
     }
     template<class T, class T1>
     static T* Alloc(T1 arg1)
     {
         auto* arena = StageArena::Instance();
-        void* memory = arena->Alloc(sizeof(T));
-        return new (memory) T(std::forward(arg1));
+        void* memory = arena->Alloc(sizeof(T), alignof(T));
+        return Track(new (memory) T(std::forward<T1>(arg1)));
     }
     template<class T, class T1, class T2>
     static T* Alloc(T1 arg1, T2 arg2)
     {
         auto* arena = StageArena::Instance();
-        void* memory = arena->Alloc(sizeof(T));
-        return new (memory) T(arg1, arg2);
+        void* memory = arena->Alloc(sizeof(T), alignof(T));
+        return Track(new (memory) T(arg1, arg2));
     }
     template<typename T>
     static T* AllocArray(size_t count)
     {
         auto* arena = StageArena::Instance();
-        // align?
-        void* memory = arena->Alloc(sizeof(T) * count);
-        return new (memory) T();
+        if (count > MAX_ARRAY_SIZE / sizeof(T)) {
+            INTEROP_FATAL("Cannot allocate memory");
+        }
+        static_assert(std::is_trivially_destructible_v<T>, "arena arrays are released without destructors");
+        void* memory = arena->Alloc(sizeof(T) * count, alignof(T));
+        return new (memory) T[count]();
     }
     template<class T>
     static T* Clone(const T& arg)
     {
         auto* arena = StageArena::Instance();
-        void* memory = arena->Alloc(sizeof(T));
-        return new (memory) T(arg);
+        void* memory = arena->Alloc(sizeof(T), alignof(T));
+        return Track(new (memory) T(arg));
     }
     template<class T>
     static std::vector<const void*>* CloneVector(const T* arg, size_t count)
     {
         return Alloc<std::vector<const void*>, const T*, const T*>(arg, arg + count);
     }
-    void* Alloc(size_t size);
+    // Bump allocation from the current slab, falls back to a new slab when exhausted.
+    void* Alloc(size_t size, size_t align = alignof(std::max_align_t))
+    {
+        auto address = reinterpret_cast<uintptr_t>(current);
+        auto aligned = (address + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+        auto limit = reinterpret_cast<uintptr_t>(end);
+        // Compared as the space left, aligned + size wraps for huge sizes
+        if (current != nullptr && aligned <= limit && size <= limit - aligned) {
+            current = reinterpret_cast<char*>(aligned + size);
+            totalSize += size;
+            return reinterpret_cast<void*>(aligned);
+        }
+        return AllocSlow(size, align);
+    }
     static char* Strdup(const char* original);
-    void Add(void* pointer);
+    // Applies to slabs allocated after the call.
+    void SetChunkSize(size_t size);
+    size_t GetChunkSize() const
+    {
+        return chunkSize;
+    }
+    size_t GetTotalSize() const
+    {
+        return totalSize;
+    }
+    Checkpoint Mark() const
+    {
+        return { chunks, large, finalizers, current, end, totalSize };
+    }
+    void Rollback(const Checkpoint& checkpoint);
+    // Nested scopes driven from the managed side, see StageArenaOpenScope.
+    size_t OpenScope();
+    void CloseScope(size_t depth);
+    size_t ScopeDepth() const
+    {
+        return scopes.size();
+    }
     void Cleanup();
+
+private:
+    std::vector<Checkpoint> scopes;
+
+    static constexpr size_t MAX_ARRAY_SIZE = 1 << 25;
 };
 
 #endif // COMMON_H
@@ -46,6 +46,12 @@ export class Es2pandaNativeModule {
     _AstNodeChildren(context: KPtr, node: KPtr): KPtr {
         throw new Error('Not implemented');
     }
+    _AstNodeChildrenHandles(context: KPtr, node: KPtr): Int32Array {
+        throw new Error('Not implemented');
+    }
+    _AstNodeParentHandle(context: KPtr, node: KPtr): KInt {
+        throw new Error('Not implemented');
+    }
     _AstNodeDumpModifiers(context: KPtr, node: KPtr): KPtr {
         throw new Error('Not implemented');
     }
@@ -55,12 +61,30 @@ export class Es2pandaNativeModule {
     _DestroyConfig(peer: KNativePointer): void {
         throw new Error('Not implemented');
     }
+    _StageArenaSetChunkSize(size: KInt): void {
+        throw new Error('Not implemented');
+    }
+    _StageArenaOpenScope(): KInt {
+        throw new Error('Not implemented');
+    }
+    _StageArenaCloseScope(depth: KInt): void {
+        throw new Error('Not implemented');
+    }
+    _InternString(str: KStringPtr): KNativePointer {
+        throw new Error('Not implemented');
+    }
     _InsertGlobalStructInfo(context: KNativePointer, str: String): void {
         throw new Error('Not implemented');
     }
     _HasGlobalStructInfo(context: KNativePointer, str: String): KBoolean {
         throw new Error('Not implemented');
     }
+    _InsertGlobalStructInfos(context: KNativePointer, names: string[], count: KInt): void {
+        throw new Error('Not implemented');
+    }
+    _HasGlobalStructInfos(context: KNativePointer, names: string[], count: KInt): Int32Array {
+        throw new Error('Not implemented');
+    }
     _ProceedToState(context: KPtr, state: number): void {
         throw new Error('Not implemented');
     }
@@ -76,12 +100,18 @@ export class Es2pandaNativeModule {
     _AstNodeSetChildrenParentPtr(context: KPtr, node: KPtr): void {
         throw new Error('Not implemented');
     }
+    _AstNodeSetParentTracked(context: KPtr, node: KPtr, parent: KPtr): void {
+        throw new Error('Not implemented');
+    }
     _AstNodeOnUpdate(context: KPtr, newNode: KPtr, replacedNode: KPtr): void {
         throw new Error('Not implemented');
     }
     _AstNodeUpdateAll(context: KPtr, node: KPtr): void {
         throw new Error('Not implemented');
     }
+    _AstNodeRepairParents(context: KPtr, roots: BigUint64Array, rootsCount: KInt): KInt {
+        throw new Error('Not implemented');
+    }
     _VariableDeclaration(context: KPtr, variable: KPtr): KPtr {
         throw new Error('Not implemented');
     }
@@ -145,6 +175,17 @@ export class Es2pandaNativeModule {
     ): void {
         throw new Error('Not implemented');
     }
+    _AstNodeListSplice(
+        context: KNativePointer,
+        receiver: KNativePointer,
+        kind: KInt,
+        start: KInt,
+        deleteCount: KInt,
+        items: BigUint64Array,
+        itemsCount: KInt
+    ): KInt {
+        throw new Error('Not implemented');
+    }
     _FilterNodes(context: KNativePointer, root: KNativePointer, filters: KStringPtr, deeperAfterMatch: KBoolean): KNativePointer {
         throw new Error('Not implemented');
     }
@@ -154,10 +195,38 @@ export class Es2pandaNativeModule {
     _FilterNodes3(context: KNativePointer, root: KNativePointer, types: Int32Array, typesSize: KInt): KNativePointer {
         throw new Error('Not implemented');
     }
+    _FilterNodesMulti(
+        context: KNativePointer,
+        root: KNativePointer,
+        queries: string[],
+        queriesCount: KInt,
+        limits: Int32Array
+    ): KNativePointer {
+        throw new Error('Not implemented');
+    }
+    _AstNodeSnapshot(context: KNativePointer, root: KNativePointer): BigUint64Array {
+        throw new Error('Not implemented');
+    }
+    _AstNodeTypes(context: KNativePointer, peers: BigUint64Array, count: KInt): Int32Array {
+        throw new Error('Not implemented');
+    }
+    _AstNodeParents(context: KNativePointer, peers: BigUint64Array, count: KInt): BigUint64Array {
+        throw new Error('Not implemented');
+    }
+    _AstNodePredicates(context: KNativePointer, peers: BigUint64Array, count: KInt, mask: KInt): Int32Array {
+        throw new Error('Not implemented');
+    }
 
     _GetAnnotationDeclarationProperties(context: KNativePointer, receiver: KNativePointer): KNativePointer {
         throw new Error('Not implemented');
     }
+    _GetAnnotationDeclarationPropertiesBatch(
+        context: KNativePointer,
+        annotationUsages: BigUint64Array,
+        count: KInt
+    ): KNativePointer {
+        throw new Error('Not implemented');
+    }
 
     // From koala-wrapper
     _ClassVariableDeclaration(context: KNativePointer, classInstance: KNativePointer): KNativePointer {
@@ -172,6 +241,15 @@ export class Es2pandaNativeModule {
     _DeclarationFromAstNode(context: KPtr, node: KPtr): KPtr {
         throw new Error('Not implemented');
     }
+    _DeclarationCacheInvalidate(context: KPtr): void {
+        throw new Error('Not implemented');
+    }
+    _DeclarationCacheRelease(context: KPtr): void {
+        throw new Error('Not implemented');
+    }
+    _DeclarationCacheStats(context: KPtr): BigUint64Array {
+        throw new Error('Not implemented');
+    }
     _ETSParserGetGlobalProgramAbsName(context: KNativePointer): KNativePointer {
         throw new Error('Not implemented');
     }
@@ -197,6 +275,12 @@ export class Es2pandaNativeModule {
     _ProgramCanSkipPhases(context: KNativePointer, program: KNativePointer): KBoolean {
         throw new Error('Not implemented');
     }
+    _ProgramsCanSkipPhases(context: KNativePointer, programs: BigUint64Array, count: KInt): Int32Array {
+        throw new Error('Not implemented');
+    }
+    _ProgramSkipPhasesRelease(context: KNativePointer): void {
+        throw new Error('Not implemented');
+    }
 
     _AstNodeProgram(context: KNativePointer, instance: KNativePointer): KNativePointer {
         throw new Error('Not implemented');
@@ -210,10 +294,45 @@ export class Es2pandaNativeModule {
         throw new Error('Not implemented');
     }
 
+    _AstNodeFindFirst(
+        context: KNativePointer,
+        root: KNativePointer,
+        types: Int32Array,
+        typesCount: KInt,
+        maxDepth: KInt,
+        flags: KInt
+    ): KNativePointer {
+        throw new Error('Not implemented');
+    }
+
+    _AstNodeFindFirstN(
+        context: KNativePointer,
+        root: KNativePointer,
+        types: Int32Array,
+        typesCount: KInt,
+        maxDepth: KInt,
+        flags: KInt,
+        limit: KInt
+    ): KNativePointer {
+        throw new Error('Not implemented');
+    }
+
     _AstNodeFindOuterParent(context: KNativePointer, node: KNativePointer, nodeType: KInt): KNativePointer {
         throw new Error('Not implemented');
     }
 
+    _AstNodeCommonAncestor(context: KNativePointer, first: KNativePointer, second: KNativePointer): KNativePointer {
+        throw new Error('Not implemented');
+    }
+
+    _AstNodeIsInside(context: KNativePointer, node: KNativePointer, ancestor: KNativePointer): KBoolean {
+        throw new Error('Not implemented');
+    }
+
+    _AncestorIndexRelease(context: KNativePointer): void {
+        throw new Error('Not implemented');
+    }
+
     _GetCompilationMode(config: KNativePointer): KInt {
         throw new Error('Not implemented');
     }
@@ -252,6 +371,35 @@ export class Es2pandaNativeModule {
     _ClassDefinitionFindSuperClassByName(context: KNativePointer, classInstance: KNativePointer, baseClassName: KStringPtr): KNativePointer {
         throw new Error('Not implemented');
     }
+    _ClassHierarchyInvalidate(context: KNativePointer): void {
+        throw new Error('Not implemented');
+    }
+    _ClassHierarchyRelease(context: KNativePointer): void {
+        throw new Error('Not implemented');
+    }
+    _ClassHierarchyFindProperty(context: KNativePointer, declaration: KNativePointer, name: KStringPtr): KNativePointer {
+        throw new Error('Not implemented');
+    }
+    _ClassHierarchyIsSubtype(context: KNativePointer, declaration: KNativePointer, base: KNativePointer): KBoolean {
+        throw new Error('Not implemented');
+    }
+    _AnnotationIndexQuery(context: KNativePointer, root: KNativePointer, names: string[], namesCount: KInt): KNativePointer {
+        throw new Error('Not implemented');
+    }
+    _AnnotationIndexUpdate(context: KNativePointer, node: KNativePointer): void {
+        throw new Error('Not implemented');
+    }
+    _AnnotationIndexRelease(context: KNativePointer): void {
+        throw new Error('Not implemented');
+    }
+    _AstNodeSetAnnotations(
+        context: KNativePointer,
+        receiver: KNativePointer,
+        annotations: BigUint64Array,
+        annotationsLength: KUInt
+    ): void {
+        throw new Error('Not implemented');
+    }
 }
 
 export function findNativeModule(): string {
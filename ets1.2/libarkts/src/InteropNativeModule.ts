@@ -46,6 +46,18 @@ export class InteropNativeModule {
     _GetPtrVectorElement(ptr: KPtr, index: KInt): KPtr {
         throw new Error('Not implemented');
     }
+    _GetPtrVectorHandles(scope: KPtr, ptr: KPtr): Int32Array {
+        throw new Error('Not implemented');
+    }
+    _GetPeerHandle(scope: KPtr, peer: KPtr): KInt {
+        throw new Error('Not implemented');
+    }
+    _ResolvePeerHandle(handle: KInt): KPtr {
+        throw new Error('Not implemented');
+    }
+    _ReleasePeerHandles(scope: KPtr): void {
+        throw new Error('Not implemented');
+    }
 }
 
 export function initInterop(): InteropNativeModule {
@@ -125,7 +125,7 @@ export abstract class AstNode extends ArktsObject {
     }
 
     public set parent(node: AstNode | undefined) {
-        global.generatedEs2panda._AstNodeSetParent(global.context, this.peer, node?.peer ?? nullptr);
+        global.es2panda._AstNodeSetParentTracked(global.context, this.peer, node?.peer ?? nullptr);
     }
 
     public get modifierFlags(): Es2pandaModifierFlags {
@@ -163,6 +163,7 @@ export abstract class AstNode extends ArktsObject {
         this.modifierFlags = original.modifierFlags;
 
         global.es2panda._AstNodeOnUpdate(global.context, this.peer, original.peer);
+        global.dirtySubtrees.mark(this.peer);
     }
 
     public get isExport(): boolean {
@@ -64,6 +64,13 @@ export class Context extends ArktsObject {
     }
 
     destroy(): void {
+        global.es2panda._DeclarationCacheRelease(this.peer);
+        global.es2panda._ClassHierarchyRelease(this.peer);
+        global.es2panda._AnnotationIndexRelease(this.peer);
+        global.es2panda._ProgramSkipPhasesRelease(this.peer);
+        global.es2panda._AncestorIndexRelease(this.peer);
+        global.interop._ReleasePeerHandles(this.peer);
+        global.handleWrappers.clear();
         compiler.destroyContext();
     }
 
@@ -71,6 +78,13 @@ export class Context extends ArktsObject {
     static destroyAndRecreate(ast: AstNode): Context {
         console.log('[TS WRAPPER] DESTROY AND RECREATE');
         const source = filterSource(ast.dumpSrc());
+        global.es2panda._DeclarationCacheRelease(global.context);
+        global.es2panda._ClassHierarchyRelease(global.context);
+        global.es2panda._AnnotationIndexRelease(global.context);
+        global.es2panda._ProgramSkipPhasesRelease(global.context);
+        global.es2panda._AncestorIndexRelease(global.context);
+        global.interop._ReleasePeerHandles(global.context);
+        global.handleWrappers.clear();
         compiler.destroyContext();
         return global.compilerContext = Context.createFromString(source);
     }
@@ -22,6 +22,7 @@ import { Context } from '../peers/Context';
 import { Profiler } from './profiler';
 import { ArkTsConfig } from '../../../generated';
 import { Config } from '../peers/Config';
+import type { AstNode } from '../peers/AstNode';
 
 export class UpdateTracker {
     stack: boolean[] = [];
@@ -39,6 +40,41 @@ export class UpdateTracker {
     }
 }
 
+// Roots of subtrees whose parent pointers may be stale, see repairParents()
+export class DirtySubtrees {
+    // Past this many roots the whole program is repaired instead, so the set stays bounded
+    static readonly LIMIT = 4096;
+
+    private peers = new Set<KNativePointer>();
+    private overflow = false;
+
+    mark(peer: KNativePointer) {
+        if (peer === nullptr || this.overflow) {
+            return;
+        }
+        this.peers.add(peer);
+        if (this.peers.size > DirtySubtrees.LIMIT) {
+            this.peers.clear();
+            this.overflow = true;
+        }
+    }
+
+    get overflowed(): boolean {
+        return this.overflow;
+    }
+
+    take(): BigUint64Array {
+        const result = new BigUint64Array(Array.from(this.peers, (peer) => BigInt(peer)));
+        this.clear();
+        return result;
+    }
+
+    clear() {
+        this.peers.clear();
+        this.overflow = false;
+    }
+}
+
 export class global {
     /** @deprecated */
     public static filePath: string = './plugins/input/main.ets';
@@ -103,8 +139,15 @@ export class global {
 
     public static clearContext(): void {
         global.compilerContext = undefined;
+        global.dirtySubtrees.clear();
+        global.handleWrappers.clear();
     }
 
     // Keep track of update info to optimize performance
     public static updateTracker: UpdateTracker = new UpdateTracker();
+
+    public static dirtySubtrees: DirtySubtrees = new DirtySubtrees();
+
+    // Wrappers of resolved peer handles, see unpackHandle(); dropped with the handles of the context
+    public static handleWrappers = new Map<number, AstNode>();
 }
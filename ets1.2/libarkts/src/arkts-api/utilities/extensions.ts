@@ -15,6 +15,7 @@
 
 import { KNativePointer, KUInt } from '@koalaui/interop';
 import type {
+    AnnotationUsage,
     ClassDefinition,
     ETSFunctionType,
     ETSModule,
@@ -53,6 +54,7 @@ export function extension_MethodDefinitionSetChildrenParentPtr(this: MethodDefin
 export function extension_MethodDefinitionOnUpdate(this: MethodDefinition, original: MethodDefinition): void {
     this.setChildrenParentPtr();
     global.es2panda._AstNodeOnUpdate(global.context, this.peer, original.peer);
+    global.dirtySubtrees.mark(this.peer);
     const originalBase = original.baseOverloadMethod;
     if (originalBase) {
         this.setBaseOverloadMethod(originalBase);
@@ -145,6 +147,13 @@ export function extension_ClassDefinitionSetBody(this: ClassDefinition, body: re
     global.es2panda._ClassDefinitionSetBody(global.context, this.peer, passNodeArray(body), body.length);
 }
 
+// Shared by every annotated node type, keeps the annotation index current
+export function extension_AstNodeSetAnnotations<T extends AstNode>(this: T, annotations: readonly AnnotationUsage[]): T {
+    const peers = passNodeArray(annotations);
+    global.es2panda._AstNodeSetAnnotations(global.context, this.peer, peers, peers.length);
+    return this;
+}
+
 // Improve: weird API
 export function extension_ETSFunctionTypeGetParamsCasted(this: ETSFunctionType): readonly ETSParameterExpression[] {
     return unpackNodeArray<ETSParameterExpression>(
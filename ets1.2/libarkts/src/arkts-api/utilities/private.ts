@@ -16,7 +16,7 @@
 import { global } from '../static/global';
 import { isNumber, throwError } from '../../utils';
 import { KInt, KNativePointer as KPtr, KNativePointer, nullptr, withString, withStringArray } from '@koalaui/interop';
-import { NativePtrDecoder } from './nativePtrDecoder';
+import { NativePtrDecoder, OptimizedNativePtrDecoder } from './nativePtrDecoder';
 import {
     Es2pandaAstNodeType,
     Es2pandaModifierFlags,
@@ -66,6 +66,9 @@ export function passNode(node: ArktsObject | undefined): KNativePointer {
     return node?.peer ?? nullptr;
 }
 
+// The external buffer path only pays off for longer arrays, see OptimizedNativePtrDecoder
+const BATCHED_UNPACK_THRESHOLD = 10;
+
 export function unpackNodeArray<T extends AstNode>(nodesPtr: KNativePointer, typeHint?: Es2pandaAstNodeType): T[] {
     if (nodesPtr === nullptr) {
         return [];
@@ -76,7 +79,40 @@ export function unpackNodeArray<T extends AstNode>(nodesPtr: KNativePointer, typ
     //    prev.push(unpackNonNullableNode(curr, typeHint))
     //    return prev
     //}, [] as T[])
-    return new NativePtrDecoder().decode(nodesPtr).map((peer: KNativePointer) => unpackNonNullableNode(peer, typeHint));
+    if (typeHint !== undefined || global.interop._GetPtrVectorSize(nodesPtr) < BATCHED_UNPACK_THRESHOLD) {
+        return new NativePtrDecoder().decode(nodesPtr).map((peer: KNativePointer) => unpackNonNullableNode(peer, typeHint));
+    }
+    // One call for the peers and one for their types instead of two calls per node
+    const peers = new OptimizedNativePtrDecoder().decode(nodesPtr);
+    const types = global.es2panda._AstNodeTypes(global.context, peers, peers.length);
+    const result: T[] = [];
+    peers.forEach((peer: KNativePointer, index: number) => result.push(unpackNonNullableNode(peer, types[index])));
+    return result;
+}
+
+/**
+ * Unpacks `groupCount` node lists packed by native as [count_0, ..., count_n-1, nodes...].
+ */
+export function unpackNodeArrayGroups<T extends AstNode>(nodesPtr: KNativePointer, groupCount: number): T[][] {
+    const result: T[][] = [];
+    if (nodesPtr === nullptr) {
+        for (let i = 0; i < groupCount; i++) {
+            result.push([]);
+        }
+        return result;
+    }
+    const decoded = new OptimizedNativePtrDecoder().decode(nodesPtr);
+    let offset = groupCount;
+    for (let i = 0; i < groupCount; i++) {
+        const count = Number(decoded[i]);
+        const group: T[] = [];
+        for (let j = 0; j < count; j++) {
+            group.push(unpackNonNullableNode(decoded[offset + j]));
+        }
+        result.push(group);
+        offset += count;
+    }
+    return result;
 }
 
 export function unpackNativeObjectArray<T extends ArktsObject>(
@@ -22,6 +22,9 @@ import {
     unpackNonNullableNode,
     unpackString,
     unpackNode,
+    unpackNodeArrayGroups,
+    passStringArray,
+    passNodeArray,
 } from './private';
 import {
     Es2pandaContextState,
@@ -137,6 +140,9 @@ export function proceedToState(state: Es2pandaContextState, _contextPtr?: KNativ
     const before = Date.now();
     traceGlobal(() => `Proceeding to state ${Es2pandaContextState[state]}: start`);
     global.es2panda._ProceedToState(global.context, state);
+    invalidateResolutionCaches();
+    global.es2panda._ProgramSkipPhasesRelease(global.context);
+    global.es2panda._AncestorIndexRelease(global.context);
     traceGlobal(() => `Proceeding to state ${Es2pandaContextState[state]}: done`);
     const after = Date.now();
     global.profiler.proceededToState(after - before);
@@ -150,6 +156,7 @@ export function rebindSubtree(node: AstNode): void {
     NodeCache.clear();
     traceGlobal(() => `Rebind: start`);
     compiler.astNodeRebind(node);
+    invalidateResolutionCaches();
     traceGlobal(() => `Rebind: done`);
     checkErrors();
 }
@@ -159,6 +166,7 @@ export function recheckSubtree(node: AstNode): void {
     NodeCache.clear();
     traceGlobal(() => `Recheck: start`);
     compiler.astNodeRecheck(node);
+    invalidateResolutionCaches();
     traceGlobal(() => `Recheck: done`);
 }
 
@@ -166,6 +174,7 @@ export function rebindContext(context: KNativePointer = global.context): void {
     NodeCache.clear();
     traceGlobal(() => `Rebind: start`);
     compiler.astNodeRebind(compiler.contextProgram().getAstCasted());
+    invalidateResolutionCaches();
     traceGlobal(() => `Rebind: done`);
     checkErrors();
 }
@@ -174,10 +183,30 @@ export function recheckContext(context: KNativePointer = global.context): void {
     NodeCache.clear();
     traceGlobal(() => `Recheck: start`);
     compiler.astNodeRecheck(compiler.contextProgram().getAstCasted());
+    invalidateResolutionCaches();
     traceGlobal(() => `Recheck: done`);
     checkErrors();
 }
 
+// Declarations and the class hierarchy depend on the binding and checking results,
+// lowerings may also add annotated nodes the annotation index has not seen
+function invalidateResolutionCaches(): void {
+    global.es2panda._DeclarationCacheInvalidate(global.context);
+    global.es2panda._ClassHierarchyInvalidate(global.context);
+    global.es2panda._AnnotationIndexRelease(global.context);
+}
+
+export interface DeclarationCacheStats {
+    hits: number;
+    misses: number;
+    entries: number;
+}
+
+export function getDeclarationCacheStats(): DeclarationCacheStats {
+    const stats = global.es2panda._DeclarationCacheStats(global.context);
+    return { hits: Number(stats[0]), misses: Number(stats[1]), entries: Number(stats[2]) };
+}
+
 export function getDecl(node: AstNode): AstNode | undefined {
     if (isMemberExpression(node)) {
         return getDeclFromArrayOrObjectMember(node);
@@ -385,6 +414,82 @@ export function findStdlib(): string {
 
 export function setAllParents(ast: AstNode): void {
     global.es2panda._AstNodeUpdateAll(global.context, ast.peer);
+    global.dirtySubtrees.clear();
+}
+
+/**
+ * Fixes parent pointers only inside the subtrees updated since the last repair
+ * (see AstNode.onUpdate), instead of walking the whole program like setAllParents.
+ * After more than DirtySubtrees.LIMIT updates the whole program is walked.
+ * Returns the number of visited nodes.
+ */
+export function repairParents(): number {
+    const roots = global.dirtySubtrees.overflowed
+        ? passNodeArray([compiler.contextProgram().getAstCasted()])
+        : global.dirtySubtrees.take();
+    global.dirtySubtrees.clear();
+    if (roots.length === 0) {
+        return 0;
+    }
+    return global.es2panda._AstNodeRepairParents(global.context, roots, roots.length);
+}
+
+/**
+ * ProgramCanSkipPhases for all programs in one native call. Answers are memoized
+ * per context until the next state change.
+ */
+export function programsCanSkipPhases(programs: readonly Program[]): boolean[] {
+    const peers = passNodeArray(programs);
+    const result = global.es2panda._ProgramsCanSkipPhases(global.context, peers, peers.length);
+    return Array.from(result, (it) => !!it);
+}
+
+/**
+ * Lowest common ancestor of the nodes (a node counts as its own ancestor),
+ * undefined if they are in different trees. Answered from the per-context
+ * ancestor index, like findOuterParent and getProgramFromAstNode.
+ */
+export function commonAncestor(first: AstNode, second: AstNode): AstNode | undefined {
+    return unpackNode(global.es2panda._AstNodeCommonAncestor(global.context, passNode(first), passNode(second)));
+}
+
+// Whether `node` is `ancestor` or one of its descendants
+export function isInside(node: AstNode, ancestor: AstNode): boolean {
+    return !!global.es2panda._AstNodeIsInside(global.context, passNode(node), passNode(ancestor));
+}
+
+/**
+ * Peer handles are small numbers standing for native peers of the current
+ * context, valid until the context is destroyed. unpackHandle keeps the wrapper
+ * of every handle it resolved, so walking the same nodes again costs neither an
+ * FFI call nor a BigInt. Handle 0 stands for null, and for a peer left without
+ * a handle once the table is full (2^22 live handles); use the peer API then.
+ */
+export type PeerHandle = number;
+
+export function getChildrenHandles(node: AstNode): Int32Array {
+    return global.es2panda._AstNodeChildrenHandles(global.context, passNode(node));
+}
+
+export function getParentHandle(node: AstNode): PeerHandle {
+    return global.es2panda._AstNodeParentHandle(global.context, passNode(node));
+}
+
+export function unpackHandle<T extends AstNode>(handle: PeerHandle): T | undefined {
+    if (handle === 0) {
+        return undefined;
+    }
+    const cached = global.handleWrappers.get(handle);
+    if (cached !== undefined) {
+        return cached as T;
+    }
+    const peer = global.interop._ResolvePeerHandle(handle);
+    if (peer === nullptr) {
+        throwError(`unknown or released peer handle ${handle}`);
+    }
+    const node = unpackNonNullableNode<T>(peer);
+    global.handleWrappers.set(handle, node);
+    return node;
 }
 
 export function getProgramFromAstNode(node: AstNode): Program | undefined {
@@ -473,6 +578,19 @@ export function logDiagnostic(kind: DiagnosticKind, pos: SourcePosition, ...args
     compiler.logDiagnostic(kind, args, pos);
 }
 
+/**
+ * Releases native scratch memory (node arrays and other results) allocated while `fn` runs.
+ * String copies handed to es2panda are not affected, they live until the stage ends.
+ */
+export function withArenaScope<T>(fn: () => T): T {
+    const depth = global.es2panda._StageArenaOpenScope();
+    try {
+        return fn();
+    } finally {
+        global.es2panda._StageArenaCloseScope(depth);
+    }
+}
+
 export function filterNodes(node: AstNode, filter: string, deeperAfterMatch: boolean): AstNode[] {
     return unpackNodeArray(global.es2panda._FilterNodes(global.context, passNode(node), filter, deeperAfterMatch));
 }
@@ -489,6 +607,211 @@ export function filterNodesByTypes(node: AstNode, types: Es2pandaAstNodeType[]):
     return unpackNodeArray(global.es2panda._FilterNodes3(global.context, passNode(node), typesArray, types.length));
 }
 
+export interface NodeSearchOptions {
+    // Children of the root have depth 1, unbounded by default
+    maxDepth?: number;
+    postOrder?: boolean;
+    includeRoot?: boolean;
+}
+
+// Keep in sync with AstSearchFlags in common.cpp
+function nodeSearchFlags(options?: NodeSearchOptions): number {
+    return (options?.postOrder ? 1 << 0 : 0) | (options?.includeRoot ? 1 << 1 : 0);
+}
+
+/**
+ * First node under `root` of one of `types` (any type if empty), the native walk stops at the match.
+ */
+export function findFirstNode<T extends AstNode = AstNode>(
+    root: AstNode,
+    types: readonly Es2pandaAstNodeType[],
+    options?: NodeSearchOptions
+): T | undefined {
+    return unpackNode<T>(
+        global.es2panda._AstNodeFindFirst(
+            global.context,
+            passNode(root),
+            Int32Array.from(types),
+            types.length,
+            options?.maxDepth ?? -1,
+            nodeSearchFlags(options)
+        )
+    );
+}
+
+/**
+ * First `limit` nodes under `root` of one of `types` (any type if empty), the native walk stops once found.
+ */
+export function findFirstNodes<T extends AstNode = AstNode>(
+    root: AstNode,
+    types: readonly Es2pandaAstNodeType[],
+    limit: number,
+    options?: NodeSearchOptions
+): T[] {
+    return unpackNodeArray(
+        global.es2panda._AstNodeFindFirstN(
+            global.context,
+            passNode(root),
+            Int32Array.from(types),
+            types.length,
+            options?.maxDepth ?? -1,
+            nodeSearchFlags(options),
+            limit
+        )
+    );
+}
+
+/**
+ * Runs several `filterNodes` queries in a single walk over the subtree and returns matches grouped per query.
+ * `limits[i] > 0` stops collecting matches of the i-th query after that many nodes.
+ */
+export function filterNodesMulti(node: AstNode, queries: string[], limits?: number[]): AstNode[][] {
+    const limitsArray = new Int32Array(queries.length);
+    for (let i = 0; i < queries.length && limits; i++) {
+        limitsArray[i] = limits[i] ?? 0;
+    }
+    return unpackNodeArrayGroups(
+        global.es2panda._FilterNodesMulti(
+            global.context,
+            passNode(node),
+            passStringArray(queries),
+            queries.length,
+            limitsArray
+        ),
+        queries.length
+    );
+}
+
+/**
+ * Flat view of a subtree, indexed by pre-order position (the root is 0).
+ * Missing parent/child/sibling links are -1, start and end are source indices.
+ */
+export interface AstSnapshot {
+    count: number;
+    peers: BigUint64Array;
+    types: Int32Array;
+    parents: Int32Array;
+    firstChildren: Int32Array;
+    nextSiblings: Int32Array;
+    starts: Int32Array;
+    ends: Int32Array;
+}
+
+export function astSnapshot(node: AstNode): AstSnapshot {
+    const data = global.es2panda._AstNodeSnapshot(global.context, passNode(node));
+    const count = Number(data[0]);
+    const column = (index: number): Int32Array =>
+        new Int32Array(data.buffer, data.byteOffset + (1 + count) * 8 + index * count * 4, count);
+    return {
+        count,
+        peers: data.subarray(1, 1 + count),
+        types: column(0),
+        parents: column(1),
+        firstChildren: column(2),
+        nextSiblings: column(3),
+        starts: column(4),
+        ends: column(5),
+    };
+}
+
+export function getNodeTypes(nodes: readonly AstNode[]): Int32Array {
+    const peers = passNodeArray(nodes);
+    return global.es2panda._AstNodeTypes(global.context, peers, peers.length);
+}
+
+export function getParents(nodes: readonly AstNode[]): (AstNode | undefined)[] {
+    const peers = passNodeArray(nodes);
+    const parents = global.es2panda._AstNodeParents(global.context, peers, peers.length);
+    return Array.from(parents, (peer) => unpackNode(peer));
+}
+
+// Node lists spliceNodeList can edit, keep in sync with AstNodeListKind in common.cpp
+export enum AstNodeListKind {
+    CLASS_BODY,
+    CLASS_IMPLEMENTS,
+    BLOCK_STATEMENTS,
+    FUNCTION_PARAMS,
+}
+
+/**
+ * Array.prototype.splice for a node list of a ClassDefinition, BlockStatement or ScriptFunction:
+ * removes `deleteCount` elements from `start` and inserts `items` there in one native call.
+ * Only the inserted nodes get their parent set. Returns the new list length.
+ */
+export function spliceNodeList(
+    node: AstNode,
+    kind: AstNodeListKind,
+    start: number,
+    deleteCount: number,
+    items: readonly AstNode[] = []
+): number {
+    const peers = passNodeArray(items);
+    const length = global.es2panda._AstNodeListSplice(
+        global.context,
+        passNode(node),
+        kind,
+        start,
+        deleteCount,
+        peers,
+        peers.length
+    );
+    if (length < 0) {
+        throwError(`Unknown node list kind ${kind}`);
+    }
+    return length;
+}
+
+// Bit positions of the predicates evaluated by getNodePredicates, keep in sync with g_nodePredicates in common.cpp
+export enum AstNodePredicate {
+    EXPRESSION = 1 << 0,
+    STATEMENT = 1 << 1,
+    TYPED = 1 << 2,
+    SCOPE_BEARER = 1 << 3,
+    EXPORTED = 1 << 4,
+    DEFAULT_EXPORTED = 1 << 5,
+    DECLARE = 1 << 6,
+    STATIC = 1 << 7,
+    PUBLIC = 1 << 8,
+    PRIVATE = 1 << 9,
+    PROTECTED = 1 << 10,
+    READONLY = 1 << 11,
+    ABSTRACT = 1 << 12,
+    FINAL = 1 << 13,
+    ASYNC = 1 << 14,
+    CONSTRUCTOR = 1 << 15,
+    OVERRIDE = 1 << 16,
+    OPTIONAL_DECLARATION = 1 << 17,
+}
+
+/**
+ * Evaluates the predicates in `mask` (a union of AstNodePredicate) for every node,
+ * the result holds the subset of `mask` that is true for the node at the same index.
+ */
+export function getNodePredicates(nodes: readonly AstNode[], mask: number): Int32Array {
+    const peers = passNodeArray(nodes);
+    return global.es2panda._AstNodePredicates(global.context, peers, peers.length, mask);
+}
+
+/**
+ * Nodes under `root` (a program AST) annotated with each of `names`, answered from
+ * a per-program index built on first use. setAnnotations, onUpdate, setBody of a
+ * class and list splices keep it current.
+ */
+export function findAnnotatedNodes(root: AstNode, names: string[]): AstNode[][] {
+    return unpackNodeArrayGroups(
+        global.es2panda._AnnotationIndexQuery(global.context, passNode(root), passStringArray(names), names.length),
+        names.length
+    );
+}
+
+/**
+ * Re-reads the annotations of `node` and its descendants on the next query, needed
+ * only after new annotated nodes are attached through other setters.
+ */
+export function updateAnnotationIndex(node: AstNode): void {
+    global.es2panda._AnnotationIndexUpdate(global.context, passNode(node));
+}
+
 export function jumpFromETSTypeReferenceToTSTypeAliasDeclarationTypeAnnotation(node: AstNode): AstNode | undefined {
     return unpackNode(
         global.es2panda._JumpFromETSTypeReferenceToTSTypeAliasDeclarationTypeAnnotation(global.context, passNode(node))
@@ -499,6 +822,30 @@ export function getAnnotationDeclarationProperties(node: AnnotationUsage): Class
     return unpackNodeArray(global.es2panda._GetAnnotationDeclarationProperties(global.context, passNode(node)));
 }
 
+/**
+ * getAnnotationDeclarationProperties for many usages in one native call,
+ * unresolved usages give empty lists.
+ */
+export function getAnnotationDeclarationPropertiesBatch(nodes: readonly AnnotationUsage[]): ClassProperty[][] {
+    const peers = passNodeArray(nodes);
+    return unpackNodeArrayGroups(
+        global.es2panda._GetAnnotationDeclarationPropertiesBatch(global.context, peers, peers.length),
+        peers.length
+    );
+}
+
+/**
+ * Finds a property (or getter/setter) named `name` on a class or interface, inherited members included.
+ * Answered from the per-context class hierarchy index.
+ */
+export function findClassProperty(declaration: AstNode, name: string): AstNode | undefined {
+    return unpackNode(global.es2panda._ClassHierarchyFindProperty(global.context, passNode(declaration), name));
+}
+
+export function isSubtypeOf(declaration: AstNode, base: AstNode): boolean {
+    return !!global.es2panda._ClassHierarchyIsSubtype(global.context, passNode(declaration), passNode(base));
+}
+
 export function findSuperClassByName(classInstance: ClassDefinition, baseClassName: string): Expression | undefined {
     return unpackNode(
         global.es2panda._ClassDefinitionFindSuperClassByName(global.context, classInstance.peer, baseClassName)
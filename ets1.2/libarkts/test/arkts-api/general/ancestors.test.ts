@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import * as util from "../../test-util"
+import * as arkts from "../../../src/arkts-api"
+import { suite, test, assert } from "@koalaui/harness"
+
+function classDefinition(module: arkts.ETSModule, name: string): arkts.ClassDefinition {
+    const declaration = module.statements.find((node: arkts.AstNode) =>
+        arkts.isClassDeclaration(node) && node.definition?.ident?.name == name
+    ) as arkts.ClassDeclaration
+    return declaration.definition!
+}
+
+suite(util.basename(__filename), () => {
+    test("find-outer-parent-after-middle-node-reparent", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(
+`
+class A {
+    foo() {
+        let x = 1
+    }
+}
+
+class B {}
+`
+        )
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const module = arkts.arktsGlobal.compilerContext!.program.ast as arkts.ETSModule
+        const a = classDefinition(module, "A")
+        const b = classDefinition(module, "B")
+
+        const method = a.body.find((node: arkts.AstNode) => arkts.isMethodDefinition(node)) as arkts.MethodDefinition
+        assert.isTrue(arkts.isFunctionExpression(method.value))
+        const body = (method.value as arkts.FunctionExpression).function!.body as arkts.BlockStatement
+        const statement = body.statements[0]
+
+        // Indexes the whole chain of the statement
+        const before = statement.findOuterParent<arkts.ClassDefinition>(
+            arkts.Es2pandaAstNodeType.AST_NODE_TYPE_CLASS_DEFINITION
+        )
+        assert.equal(before?.ident?.name, "A")
+
+        // Re-parents an indexed node in the middle of the chain
+        method.parent = b
+
+        const after = statement.findOuterParent<arkts.ClassDefinition>(
+            arkts.Es2pandaAstNodeType.AST_NODE_TYPE_CLASS_DEFINITION
+        )
+        assert.equal(after?.ident?.name, "B")
+
+        arkts.arktsGlobal.compilerContext?.destroy()
+        arkts.arktsGlobal.configObj?.destroy()
+    })
+
+    test("find-inner-child-returns-last-match", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(
+`
+class A {
+    first: number = 1
+    second: number = 2
+}
+`
+        )
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const module = arkts.arktsGlobal.compilerContext!.program.ast as arkts.ETSModule
+        const a = classDefinition(module, "A")
+
+        // Last in pre-order, as the AstNodeForEach based lookup returned
+        const property = a.findInnerChild<arkts.ClassProperty>(
+            arkts.Es2pandaAstNodeType.AST_NODE_TYPE_CLASS_PROPERTY
+        )
+        assert.equal((property?.key as arkts.Identifier | undefined)?.name, "second")
+
+        arkts.arktsGlobal.compilerContext?.destroy()
+        arkts.arktsGlobal.configObj?.destroy()
+    })
+})
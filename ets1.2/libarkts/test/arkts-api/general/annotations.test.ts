@@ -50,4 +50,100 @@ suite(util.basename(__filename), () => {
         arkts.arktsGlobal.compilerContext?.destroy();
         arkts.arktsGlobal.configObj?.destroy();
     })
+
+    test("annotation-index-replaced-subtree", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(
+`
+@interface memo {}
+
+class A {
+    @memo
+    foo() {}
+
+    bar() {}
+}
+
+class B {
+    @memo
+    baz() {}
+}
+`
+        )
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const module = arkts.arktsGlobal.compilerContext!.program.ast
+        const definition = (name: string) => (module.statements.find((node: arkts.AstNode) =>
+            arkts.isClassDeclaration(node) && node.definition?.ident?.name == name
+        ) as arkts.ClassDeclaration).definition!
+        const methodName = (node: arkts.AstNode) => (node as arkts.ScriptFunction).id?.name
+
+        const before = arkts.findAnnotatedNodes(module, ["memo"])[0]
+        assert.equal(before.map(methodName).join(', '), 'foo, baz')
+
+        // Replaces the body of A: drops the annotated foo and inserts a copy of the annotated baz
+        const a = definition("A")
+        const bar = a.body.find((node: arkts.AstNode) =>
+            arkts.isMethodDefinition(node) && node.id?.name == "bar"
+        )!
+        const baz = definition("B").body.find((node: arkts.AstNode) => arkts.isMethodDefinition(node))!
+        arkts.factory.updateClassDefinition(
+            a,
+            a.ident,
+            a.typeParams,
+            a.superTypeParams,
+            a.implements,
+            undefined,
+            a.super,
+            [bar, baz.clone()],
+            a.modifiers,
+            a.modifierFlags
+        )
+
+        const after = arkts.findAnnotatedNodes(module, ["memo"])[0]
+        assert.equal(after.map(methodName).sort().join(', '), 'baz, baz')
+        assert.isFalse(after.some((node: arkts.AstNode) => before[0].peer == node.peer))
+
+        arkts.arktsGlobal.compilerContext?.destroy();
+        arkts.arktsGlobal.configObj?.destroy();
+    })
+
+    test("annotation-index-set-annotations", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(
+`
+@interface memo {}
+
+class A {
+    @memo
+    foo() {}
+
+    bar() {}
+}
+`
+        )
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const module = arkts.arktsGlobal.compilerContext!.program.ast
+        const a = (module.statements.find((node: arkts.AstNode) =>
+            arkts.isClassDeclaration(node)
+        ) as arkts.ClassDeclaration).definition!
+        const method = (name: string) => (a.body.find((node: arkts.AstNode) =>
+            arkts.isMethodDefinition(node) && node.id?.name == name
+        ) as arkts.MethodDefinition).function!
+        const methodName = (node: arkts.AstNode) => (node as arkts.ScriptFunction).id?.name
+
+        assert.equal(arkts.findAnnotatedNodes(module, ["memo"])[0].map(methodName).join(', '), 'foo')
+
+        // Moves the annotation from foo to bar without updateAnnotationIndex
+        const foo = method("foo")
+        const annotations = foo.annotations
+        method("bar").setAnnotations(annotations.map((it: arkts.AnnotationUsage) => it.clone()))
+        foo.setAnnotations([])
+
+        assert.equal(arkts.findAnnotatedNodes(module, ["memo"])[0].map(methodName).join(', '), 'bar')
+
+        arkts.arktsGlobal.compilerContext?.destroy();
+        arkts.arktsGlobal.configObj?.destroy();
+    })
 })
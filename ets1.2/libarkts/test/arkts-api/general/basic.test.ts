@@ -91,6 +91,126 @@ struct Moo {}
         assert.equal(structs.length, 2)
         assert.equal((structs[0] as arkts.ETSStructDeclaration).definition.ident!.name, "Noo")
 
+        arkts.arktsGlobal.compilerContext?.destroy();
+        arkts.arktsGlobal.configObj?.destroy();
+    })
+    test("filter-multi", function() {
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(
+`
+@interface memo {}
+
+struct Noo {}
+
+class Foo {
+    @memo
+    foo1() {}
+
+    bar: int = 42
+    foo2() {}
+
+    @memo
+    foo3() {}
+}
+
+struct Moo {}
+`
+        )
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const program = arkts.arktsGlobal.compilerContext!.program
+        const peers = (nodes: arkts.AstNode[]) => nodes.map((node) => node.peer)
+        const queries = [
+            "type=function;annotation=memo",
+            "type=struct",
+            "type=function;annotation=memo",
+            "type=identifier;depth=2",
+            "type=function;annotation=missing",
+            "type=identifier",
+        ]
+        const groups = arkts.filterNodesMulti(program.ast, queries, [0, 0, 1, 0, 0, 3])
+
+        // One group per query, in query order, each as filterNodes would return it
+        assert.equal(groups.length, queries.length)
+        assert.equal(groups[0].length, 2)
+        assert.equal((groups[0][0] as arkts.ScriptFunction).id!.name, "foo1")
+        assert.equal((groups[0][1] as arkts.ScriptFunction).id!.name, "foo3")
+        assert.deepEqual(peers(groups[1]), peers(arkts.filterNodes(program.ast, queries[1], false)))
+        assert.deepEqual(peers(groups[3]), peers(arkts.filterNodes(program.ast, queries[3], false)))
+        assert.equal(groups[4].length, 0)
+
+        // Limits cut a group after the first matches, other groups are not affected
+        assert.deepEqual(peers(groups[2]), peers(groups[0].slice(0, 1)))
+        assert.deepEqual(peers(groups[5]), peers(arkts.filterNodes(program.ast, queries[5], false).slice(0, 3)))
+
+        // depth bounds the walk of its own query only
+        assert.isTrue(groups[3].length < arkts.filterNodes(program.ast, "type=identifier", false).length)
+
+        arkts.arktsGlobal.compilerContext?.destroy();
+        arkts.arktsGlobal.configObj?.destroy();
+    })
+    test("struct-info-batch", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(
+`
+struct Noo {}
+`
+        )
+        const es2panda = arkts.arktsGlobal.es2panda
+        const context = arkts.arktsGlobal.context
+
+        // A count past the names inserts only the decoded ones
+        es2panda._InsertGlobalStructInfos(context, ["BatchNoo", "BatchMoo"], 3)
+        es2panda._InsertGlobalStructInfo(context, "BatchSingle")
+
+        const names = ["BatchNoo", "BatchMissing", "BatchMoo", "BatchSingle"]
+        assert.deepEqual(Array.from(es2panda._HasGlobalStructInfos(context, names, names.length)), [1, 0, 1, 1])
+        assert.isTrue(!!es2panda._HasGlobalStructInfo(context, "BatchMoo"))
+
+        // One flag per requested name, names past the decoded ones are not registered
+        assert.deepEqual(Array.from(es2panda._HasGlobalStructInfos(context, names, 6)), [1, 0, 1, 1, 0, 0])
+        assert.equal(es2panda._HasGlobalStructInfos(context, [], 0).length, 0)
+
+        arkts.arktsGlobal.compilerContext?.destroy();
+        arkts.arktsGlobal.configObj?.destroy();
+    })
+    test("arena-scope", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(
+`
+class Foo {
+    foo() {}
+}
+`
+        )
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const es2panda = arkts.arktsGlobal.es2panda
+        const program = arkts.arktsGlobal.compilerContext!.program
+        const probeDepth = () => {
+            const depth = es2panda._StageArenaOpenScope()
+            es2panda._StageArenaCloseScope(depth)
+            return depth
+        }
+        const base = probeDepth()
+
+        // Results and nested scopes, the scratch arrays of the walk are released on return
+        const [methods, nested, ident] = arkts.withArenaScope(() => {
+            const found = arkts.filterNodes(program.ast, "type=method", false)
+            const depth = arkts.withArenaScope(probeDepth)
+            return [found, depth, arkts.factory.createIdentifier("renamed")] as const
+        })
+        assert.equal(nested, base + 2)
+        assert.equal(probeDepth(), base)
+        assert.equal(methods.length, 1)
+        assert.equal((methods[0] as arkts.MethodDefinition).id!.name, "foo")
+
+        // Strings handed to es2panda inside the scope outlive it
+        assert.equal(ident.name, "renamed")
+
+        // A throwing callback still closes its scope
+        assert.throws(() => arkts.withArenaScope(() => { throw new Error("stage failed") }))
+        assert.equal(probeDepth(), base)
+
         arkts.arktsGlobal.compilerContext?.destroy();
         arkts.arktsGlobal.configObj?.destroy();
     })
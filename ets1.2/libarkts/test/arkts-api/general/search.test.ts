@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import * as util from "../../test-util"
+import * as arkts from "../../../src/arkts-api"
+import { suite, test, assert } from "@koalaui/harness"
+
+const source =
+`
+class A {
+    first: number = 1
+    second: number = 2
+}
+
+class B {
+    third: number = 3
+}
+`
+
+const CLASS_PROPERTY = arkts.Es2pandaAstNodeType.AST_NODE_TYPE_CLASS_PROPERTY
+const CLASS_DEFINITION = arkts.Es2pandaAstNodeType.AST_NODE_TYPE_CLASS_DEFINITION
+const IDENTIFIER = arkts.Es2pandaAstNodeType.AST_NODE_TYPE_IDENTIFIER
+
+function propertyName(node: arkts.AstNode | undefined): string | undefined {
+    return ((node as arkts.ClassProperty | undefined)?.key as arkts.Identifier | undefined)?.name
+}
+
+suite(util.basename(__filename), () => {
+    test("find-first-node", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(source)
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const module = arkts.arktsGlobal.compilerContext!.program.ast
+        const a = arkts.findFirstNode<arkts.ClassDefinition>(module, [CLASS_DEFINITION])!
+        assert.equal(a.ident?.name, "A")
+
+        // No types match any node, the root is skipped unless asked for
+        assert.equal(arkts.findFirstNode(module, [])?.peer, module.getChildren()[0].peer)
+        assert.isTrue(arkts.findFirstNode(a, [CLASS_DEFINITION]) === undefined)
+        assert.equal(arkts.findFirstNode(a, [CLASS_DEFINITION], { includeRoot: true })?.peer, a.peer)
+
+        // Post-order reaches the key of the property before the property itself
+        const first = arkts.findFirstNode(module, [CLASS_PROPERTY])!
+        assert.equal(propertyName(first), "first")
+        const preOrder = arkts.findFirstNode(first, [CLASS_PROPERTY, IDENTIFIER], { includeRoot: true })
+        assert.equal(preOrder?.peer, first.peer)
+        const postOrder = arkts.findFirstNode(first, [CLASS_PROPERTY, IDENTIFIER], { includeRoot: true, postOrder: true })
+        assert.equal((postOrder as arkts.Identifier).name, "first")
+
+        // Properties sit at depth 3: declaration, definition, property
+        assert.isTrue(arkts.findFirstNode(module, [CLASS_PROPERTY], { maxDepth: 2 }) === undefined)
+        assert.equal(propertyName(arkts.findFirstNode(module, [CLASS_PROPERTY], { maxDepth: 3 })), "first")
+
+        arkts.arktsGlobal.compilerContext?.destroy()
+        arkts.arktsGlobal.configObj?.destroy()
+    })
+
+    test("find-first-nodes", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(source)
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const module = arkts.arktsGlobal.compilerContext!.program.ast
+        const names = (nodes: arkts.AstNode[]) => nodes.map(propertyName).join(', ')
+
+        // Stops at the limit, 0 collects all matches like filterNodesByType
+        assert.equal(names(arkts.findFirstNodes(module, [CLASS_PROPERTY], 2)), "first, second")
+        assert.equal(names(arkts.findFirstNodes(module, [CLASS_PROPERTY], 0)), "first, second, third")
+        assert.deepEqual(
+            arkts.findFirstNodes(module, [CLASS_PROPERTY], 0).map((node) => node.peer),
+            arkts.filterNodesByType(module, CLASS_PROPERTY).map((node) => node.peer)
+        )
+        assert.equal(names(arkts.findFirstNodes(module, [CLASS_PROPERTY], 10)), "first, second, third")
+
+        // The depth bound applies to every match
+        assert.equal(arkts.findFirstNodes(module, [CLASS_PROPERTY], 0, { maxDepth: 2 }).length, 0)
+
+        arkts.arktsGlobal.compilerContext?.destroy()
+        arkts.arktsGlobal.configObj?.destroy()
+    })
+})
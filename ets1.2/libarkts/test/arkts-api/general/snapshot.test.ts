@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import * as util from "../../test-util"
+import * as arkts from "../../../src/arkts-api"
+import { suite, test, assert } from "@koalaui/harness"
+
+suite(util.basename(__filename), () => {
+    test("ast-snapshot-matches-subtree", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(
+`
+class A {
+    foo(x: int): int {
+        return x + 1
+    }
+}
+
+function bar() {}
+`
+        )
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const module = arkts.arktsGlobal.compilerContext!.program.ast
+        const snapshot = arkts.astSnapshot(module)
+        const subtree = module.getSubtree()
+
+        // Pre-order, the root is 0
+        assert.equal(snapshot.count, subtree.length)
+        assert.deepEqual(Array.from(snapshot.peers), subtree.map((node) => BigInt(node.peer)))
+        assert.deepEqual(Array.from(snapshot.types), Array.from(arkts.getNodeTypes(subtree)))
+        assert.equal(snapshot.parents[0], -1)
+        assert.equal(snapshot.nextSiblings[0], -1)
+        assert.equal(snapshot.starts[0], module.startPosition.getIndex())
+        assert.equal(snapshot.ends[0], module.endPosition.getIndex())
+
+        // Links agree with getChildren: children of a node are its first child and its siblings
+        for (let i = 0; i < snapshot.count; i++) {
+            const children: bigint[] = []
+            for (let child = snapshot.firstChildren[i]; child != -1; child = snapshot.nextSiblings[child]) {
+                assert.equal(snapshot.parents[child], i)
+                children.push(snapshot.peers[child])
+            }
+            assert.deepEqual(children, subtree[i].getChildren().map((node) => BigInt(node.peer)))
+        }
+
+        arkts.arktsGlobal.compilerContext?.destroy();
+        arkts.arktsGlobal.configObj?.destroy();
+    })
+
+    test("ast-snapshot-of-a-leaf", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(
+`
+let x = 1
+`
+        )
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const module = arkts.arktsGlobal.compilerContext!.program.ast
+        const leaf = arkts.findFirstNode(module, [arkts.Es2pandaAstNodeType.AST_NODE_TYPE_NUMBER_LITERAL])!
+        const snapshot = arkts.astSnapshot(leaf)
+
+        // A subtree snapshot does not link the root to its real parent
+        assert.equal(snapshot.count, 1)
+        assert.equal(snapshot.peers[0], BigInt(leaf.peer))
+        assert.equal(snapshot.parents[0], -1)
+        assert.equal(snapshot.firstChildren[0], -1)
+
+        arkts.arktsGlobal.compilerContext?.destroy();
+        arkts.arktsGlobal.configObj?.destroy();
+    })
+})
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2025 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import * as util from "../../test-util"
+import * as arkts from "../../../src/arkts-api"
+import { suite, test, assert } from "@koalaui/harness"
+
+const source =
+`
+class A {
+    a: int = 1
+    b: int = 2
+    c: int = 3
+}
+
+function f() {
+    let x = 1
+    let y = 2
+}
+`
+
+function classDefinition(module: arkts.ETSModule): arkts.ClassDefinition {
+    const declaration = module.statements.find((node: arkts.AstNode) =>
+        arkts.isClassDeclaration(node)
+    ) as arkts.ClassDeclaration
+    return declaration.definition!
+}
+
+function propertyNames(definition: arkts.ClassDefinition): string {
+    return definition.body
+        .filter((node: arkts.AstNode) => arkts.isClassProperty(node))
+        .map((node: arkts.AstNode) => ((node as arkts.ClassProperty).key as arkts.Identifier).name)
+        .join(', ')
+}
+
+function indexOf(definition: arkts.ClassDefinition, node: arkts.AstNode): number {
+    return definition.body.findIndex((member: arkts.AstNode) => member.peer == node.peer)
+}
+
+function property(definition: arkts.ClassDefinition, name: string): arkts.ClassProperty {
+    return definition.body.find((node: arkts.AstNode) =>
+        arkts.isClassProperty(node) && (node.key as arkts.Identifier).name == name
+    ) as arkts.ClassProperty
+}
+
+suite(util.basename(__filename), () => {
+    test("splice-class-body", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(source)
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const module = arkts.arktsGlobal.compilerContext!.program.ast as arkts.ETSModule
+        const a = classDefinition(module)
+        const length = a.body.length
+        const first = indexOf(a, property(a, "a"))
+
+        // Empty insert only removes
+        const b = property(a, "b")
+        assert.equal(arkts.spliceNodeList(a, arkts.AstNodeListKind.CLASS_BODY, indexOf(a, b), 1), length - 1)
+        assert.equal(propertyNames(a), "a, c")
+
+        // Same count replaces in place, the inserted node gets its parent
+        assert.equal(arkts.spliceNodeList(a, arkts.AstNodeListKind.CLASS_BODY, first, 1, [b]), length - 1)
+        assert.equal(propertyNames(a), "b, c")
+        assert.equal(b.parent?.peer, a.peer)
+
+        // Out-of-range start appends, deleteCount is clamped to the elements left
+        const copy = property(a, "c").clone()
+        assert.equal(arkts.spliceNodeList(a, arkts.AstNodeListKind.CLASS_BODY, 1000, 5, [copy]), length)
+        assert.equal(propertyNames(a), "b, c, c")
+        assert.equal(copy.parent?.peer, a.peer)
+
+        // Nothing to remove or insert leaves the list as is
+        assert.equal(arkts.spliceNodeList(a, arkts.AstNodeListKind.CLASS_BODY, 0, 0, []), length)
+        assert.equal(propertyNames(a), "b, c, c")
+
+        arkts.arktsGlobal.compilerContext?.destroy()
+        arkts.arktsGlobal.configObj?.destroy()
+    })
+
+    test("splice-block-statements", function() {
+        util.initConfig()
+
+        arkts.arktsGlobal.compilerContext = arkts.Context.createFromString(source)
+        arkts.proceedToState(arkts.Es2pandaContextState.ES2PANDA_STATE_PARSED)
+        const module = arkts.arktsGlobal.compilerContext!.program.ast as arkts.ETSModule
+        const declaration = module.statements.find((node: arkts.AstNode) =>
+            arkts.isFunctionDeclaration(node)
+        ) as arkts.FunctionDeclaration
+        const body = declaration.function!.body as arkts.BlockStatement
+        const [x, y] = body.statements
+
+        // Inserts in the middle without removing, the list is rebuilt once
+        const copy = y.clone()
+        assert.equal(arkts.spliceNodeList(body, arkts.AstNodeListKind.BLOCK_STATEMENTS, 1, 0, [copy]), 3)
+        assert.deepEqual(body.statements.map((node: arkts.AstNode) => node.peer), [x.peer, copy.peer, y.peer])
+        assert.equal(copy.parent?.peer, body.peer)
+
+        // Negative start is taken as 0
+        assert.equal(arkts.spliceNodeList(body, arkts.AstNodeListKind.BLOCK_STATEMENTS, -1, 2), 1)
+        assert.deepEqual(body.statements.map((node: arkts.AstNode) => node.peer), [y.peer])
+
+        assert.throws(() => arkts.spliceNodeList(body, 42 as arkts.AstNodeListKind, 0, 0))
+
+        arkts.arktsGlobal.compilerContext?.destroy()
+        arkts.arktsGlobal.configObj?.destroy()
+    })
+})
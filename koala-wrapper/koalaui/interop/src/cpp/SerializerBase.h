@@ -16,6 +16,7 @@
 #ifndef _SERIALIZER_BASE_H
 #define _SERIALIZER_BASE_H
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
@@ -66,6 +67,58 @@ T* allocArray(const std::array<T, size>& ref) {
   return array;
 }
 
+/*
+ * Per-thread cache of serializer buffers, so that serializers created on hot callback
+ * and marshaling paths reuse the storage of the previous ones instead of going to malloc.
+ * Buffers grown past MAX_POOLED_LENGTH are freed, not cached.
+ */
+class SerializerBufferPool {
+public:
+    static constexpr uint32_t INITIAL_LENGTH = 256;
+    static constexpr uint32_t MAX_POOLED_LENGTH = 1024 * 1024;
+    static constexpr size_t MAX_POOLED_BUFFERS = 8;
+
+    static SerializerBufferPool& instance() {
+        static thread_local SerializerBufferPool pool;
+        return pool;
+    }
+
+    uint8_t* acquire(uint32_t& length) {
+        if (count > 0) {
+            count--;
+            length = buffers[count].length;
+            return buffers[count].data;
+        }
+        length = INITIAL_LENGTH;
+        return reinterpret_cast<uint8_t*>(malloc(length));
+    }
+
+    void release(uint8_t* data, uint32_t length) {
+        if (data == nullptr) {
+            return;
+        }
+        if (count == MAX_POOLED_BUFFERS || length > MAX_POOLED_LENGTH) {
+            free(data);
+            return;
+        }
+        buffers[count++] = { data, length };
+    }
+
+    ~SerializerBufferPool() {
+        for (size_t i = 0; i < count; i++) {
+            free(buffers[i].data);
+        }
+    }
+
+private:
+    struct Buffer {
+        uint8_t* data;
+        uint32_t length;
+    };
+    Buffer buffers[MAX_POOLED_BUFFERS] = {};
+    size_t count = 0;
+};
+
 class SerializerBase {
 private:
     uint8_t* data;
@@ -78,6 +131,7 @@ private:
         ASSERT(newLength > dataLength);
         auto* newData = reinterpret_cast<uint8_t*>(malloc(newLength));
         if (newData == nullptr) {
+            INTEROP_FATAL("Cannot grow serializer buffer to %u bytes\n", newLength);
             return;
         }
 #ifdef __STDC_LIB_EXT1__
@@ -91,12 +145,25 @@ private:
 #endif
         free(data);
         data = newData;
+        dataLength = newLength;
+    }
+
+    // Copies after a check() covering the size, the only bounds check of bulk writers
+    void writeRaw(const void* source, size_t size) {
+#ifdef __STDC_LIB_EXT1__
+        errno_t res = memcpy_s(data + position, dataLength - position, source, size);
+        if (res != EOK) {
+            return;
+        }
+#else
+        memcpy(data + position, source, size);
+#endif
+        position += size;
     }
 public:
     SerializerBase(CallbackResourceHolder* resourceHolder = nullptr):
         position(0), ownData(true), resourceHolder(resourceHolder) {
-        this->dataLength = 256;
-        this->data = reinterpret_cast<uint8_t*>(malloc(this->dataLength));
+        this->data = SerializerBufferPool::instance().acquire(this->dataLength);
     }
 
     SerializerBase(uint8_t* data, uint32_t dataLength, CallbackResourceHolder* resourceHolder = nullptr):
@@ -105,7 +172,7 @@ public:
 
     virtual ~SerializerBase() {
         if (ownData) {
-            free(data);
+            SerializerBufferPool::instance().release(data, dataLength);
         }
     }
 
@@ -120,12 +187,18 @@ public:
         return position;
     }
 
-    inline void check(int more) {
+    inline void check(size_t more) {
         if (position + more > dataLength) {
             if (ownData) {
-                resize(dataLength * 3 / 2 + 2);
+                // Grow geometrically, and at least enough for a large bulk write
+                size_t newLength = std::max<size_t>(static_cast<size_t>(dataLength) * 2, position + more);
+                if (newLength > UINT32_MAX) {
+                    INTEROP_FATAL("Buffer overrun: %zu > %u\n", position + more, UINT32_MAX);
+                    return;
+                }
+                resize(static_cast<uint32_t>(newLength));
             } else {
-                INTEROP_FATAL("Buffer overrun: %d > %d\n", position + more, dataLength);
+                INTEROP_FATAL("Buffer overrun: %zu > %u\n", position + more, dataLength);
             }
         }
     }
@@ -208,7 +281,7 @@ public:
         check(8);
 #ifdef KOALA_NO_UNALIGNED_ACCESS
 #ifdef __STDC_LIB_EXT1__
-        errno_t res = memcpy_s(data + position, dataLength, &value64, 8);
+        errno_t res = memcpy_s(data + position, dataLength, &value, 8);
         if (res != EOK) {
             return;
         }
@@ -221,6 +294,37 @@ public:
         position += 8;
     }
 
+    // Writes the count followed by the values, as writeInt32() for each would
+    void writeInt32Array(const InteropInt32* values, InteropInt32 count) {
+        check(sizeof(InteropInt32) + static_cast<size_t>(count) * sizeof(InteropInt32));
+        writeRaw(&count, sizeof(count));
+        writeRaw(values, static_cast<size_t>(count) * sizeof(InteropInt32));
+    }
+
+    void writePointerArray(const InteropNativePointer* values, InteropInt32 count) {
+        check(sizeof(InteropInt32) + static_cast<size_t>(count) * sizeof(int64_t));
+        writeRaw(&count, sizeof(count));
+        for (InteropInt32 i = 0; i < count; i++) {
+            auto value = static_cast<int64_t>(reinterpret_cast<intptr_t>(values[i]));
+            writeRaw(&value, sizeof(value));
+        }
+    }
+
+    void writeStringArray(const InteropString* values, InteropInt32 count) {
+        size_t size = sizeof(InteropInt32);
+        for (InteropInt32 i = 0; i < count; i++) {
+            size += sizeof(InteropInt32) + values[i].length + 1;
+        }
+        check(size);
+        writeRaw(&count, sizeof(count));
+        for (InteropInt32 i = 0; i < count; i++) {
+            InteropInt32 length = values[i].length + 1;
+            writeRaw(&length, sizeof(length));
+            writeRaw(values[i].chars, values[i].length);
+            data[position++] = 0;
+        }
+    }
+
     void writeFunction(InteropFunction value) {
         // TODO: ignored, remove!
         writeInt32(0x666);
@@ -17,106 +17,439 @@
 #include "common-interop.h"
 #include "interop-types.h"
 #include "callback-resource.h"
-#include <deque>
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
+/*
+ * Callback events waiting for the managed side, in one growable ring. Events handed
+ * out by a check or drain stay in the ring until the next one, as the managed side
+ * may still be reading their resources, and are then released together.
+ */
+class CallbackEventQueue {
+public:
+    struct Event {
+        CallbackEventKind kind;
+        InteropInt32 resourceId;
+        CallbackBuffer callback;
+    };
+
+    bool empty() const
+    {
+        return count == handedOut;
+    }
+
+    size_t pending() const
+    {
+        return count - handedOut;
+    }
+
+    void push(Event&& event)
+    {
+        if (count == slots.size()) {
+            grow();
+        }
+        slots[(head + count) % slots.size()] = std::move(event);
+        count++;
+    }
+
+    // Next event not handed out yet, the queue must not be empty
+    Event& next()
+    {
+        return slots[(head + handedOut) % slots.size()];
+    }
+
+    void handOut()
+    {
+        handedOut++;
+    }
+
+    // Releases all events handed out so far
+    void releaseHandedOut()
+    {
+        for (; handedOut > 0; handedOut--) {
+            Event& event = slots[head];
+            if (event.kind == Event_CallCallback) {
+                event.callback.resourceHolder.release();
+            }
+            head = (head + 1) % slots.size();
+            count--;
+        }
+    }
+
+private:
+    static constexpr size_t INITIAL_CAPACITY = 64;
+
+    std::vector<Event> slots;
+    size_t head = 0;
+    size_t count = 0;
+    size_t handedOut = 0;
+
+    void grow()
+    {
+        std::vector<Event> grown(std::max(INITIAL_CAPACITY, slots.size() * 2));
+        for (size_t i = 0; i < count; i++) {
+            grown[i] = std::move(slots[(head + i) % slots.size()]);
+        }
+        slots = std::move(grown);
+        head = 0;
+    }
+};
+
+/*
+ * Bounded lock-free multi-producer single-consumer queue (Vyukov's array queue) for
+ * events posted by any thread. The managed thread moves them into its own queue
+ * before handing events out.
+ */
+class CallbackEventChannel {
+public:
+    static constexpr size_t CAPACITY = 4096;
+
+    CallbackEventChannel() : cells(CAPACITY)
+    {
+        for (size_t i = 0; i < CAPACITY; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPush(CallbackEventQueue::Event&& event)
+    {
+        size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        for (;;) {
+            cell = &cells[position & (CAPACITY - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        cell->event = std::move(event);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
 
-static bool needReleaseFront = false;
-static std::deque<CallbackEventKind> callbackEventsQueue;
-static std::deque<CallbackBuffer> callbackCallSubqueue;
-static std::deque<InteropInt32> callbackResourceSubqueue;
+    // Consumer only
+    bool hasEvents() const
+    {
+        return cells[dequeuePosition & (CAPACITY - 1)].sequence.load(std::memory_order_acquire) == dequeuePosition + 1;
+    }
+
+    // Consumer only
+    bool tryPop(CallbackEventQueue::Event& event)
+    {
+        Cell& cell = cells[dequeuePosition & (CAPACITY - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+            return false;
+        }
+        event = std::move(cell.event);
+        cell.sequence.store(dequeuePosition + CAPACITY, std::memory_order_release);
+        dequeuePosition++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        CallbackEventQueue::Event event;
+    };
+
+    std::vector<Cell> cells;
+    std::atomic<size_t> enqueuePosition { 0 };
+    size_t dequeuePosition = 0;
+};
+
+static CallbackEventQueue callbackEvents;
+static CallbackEventChannel postedEvents;
+// The managed thread, the only one draining events
+static std::atomic<std::thread::id> consumerThread;
+
+/*
+ * Events posted while no consumer is registered and the channel is full. The poster
+ * may be the future consumer itself, so it must not wait. Once spilling started, all
+ * producers append here until the consumer takes the list, which keeps their order.
+ */
+static std::mutex spillMutex;
+static std::vector<CallbackEventQueue::Event> spilledEvents;
+static std::atomic<bool> spilling { false };
+
+// Wakes up the consumer waiting for events and producers waiting for space
+static std::mutex waitMutex;
+static std::condition_variable eventsPosted;
+static std::condition_variable spaceFreed;
+static std::atomic<int> waitingConsumers { 0 };
+static std::atomic<int> waitingProducers { 0 };
+static std::atomic<bool> wakeupPending { false };
+static std::atomic<void (*)(void*)> wakeupHook { nullptr };
+static std::atomic<void*> wakeupContext { nullptr };
+
+void setCallbackEventWakeup(void (*hook)(void* context), void* context)
+{
+    wakeupContext.store(context, std::memory_order_relaxed);
+    wakeupHook.store(hook, std::memory_order_release);
+}
+
+// Call on the managed thread at init, before any event is posted
+void registerCallbackEventConsumer()
+{
+    consumerThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+}
+
+// The bridges below only run on the managed thread, they register it if init did not
+static void ensureCallbackEventConsumer()
+{
+    std::thread::id none;
+    consumerThread.compare_exchange_strong(none, std::this_thread::get_id(), std::memory_order_relaxed);
+}
+
+static bool isCallbackEventConsumer()
+{
+    return consumerThread.load(std::memory_order_relaxed) == std::this_thread::get_id();
+}
+
+/*
+ * Moves posted events into the consumer queue, on the managed thread only. Unless all
+ * are asked for, stops once a channel worth of events is pending, so a slow consumer
+ * blocks the producers instead of growing the queue. Spilled events are only taken
+ * after the channel is empty, as they were posted after everything in it.
+ */
+static void acceptPostedEvents(bool all = false)
+{
+    wakeupPending.store(false, std::memory_order_relaxed);
+    CallbackEventQueue::Event event;
+    bool accepted = false;
+    while ((all || callbackEvents.pending() < CallbackEventChannel::CAPACITY) && postedEvents.tryPop(event)) {
+        callbackEvents.push(std::move(event));
+        accepted = true;
+    }
+    if (spilling.load(std::memory_order_acquire) && (all || !postedEvents.hasEvents())) {
+        std::lock_guard<std::mutex> lock(spillMutex);
+        for (auto& spilled : spilledEvents) {
+            callbackEvents.push(std::move(spilled));
+        }
+        spilledEvents.clear();
+        spilling.store(false, std::memory_order_release);
+        accepted = true;
+    }
+    if (accepted && waitingProducers.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        spaceFreed.notify_all();
+    }
+}
+
+static void notifyConsumer()
+{
+    // Pairs with the fence in impl_WaitCallbackEvents, so either side sees the other
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waitingConsumers.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        eventsPosted.notify_all();
+    }
+    // One wakeup per batch, re-armed by the next drain
+    auto hook = wakeupHook.load(std::memory_order_acquire);
+    if (hook != nullptr && !wakeupPending.exchange(true, std::memory_order_acq_rel)) {
+        hook(wakeupContext.load(std::memory_order_relaxed));
+    }
+}
+
+// Appends to the spilled events if spilling is on or is to be started, returns whether it did
+static bool spillEvent(CallbackEventQueue::Event& event, bool start)
+{
+    std::lock_guard<std::mutex> lock(spillMutex);
+    if (!start && !spilling.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    spilledEvents.push_back(std::move(event));
+    spilling.store(true, std::memory_order_release);
+    return true;
+}
+
+/*
+ * Safe to call from any thread. The managed thread takes everything posted before
+ * and then queues directly, so its own events never overtake earlier ones of other
+ * threads, and it never blocks. Other threads wait while the bounded channel is full
+ * until the managed thread drains it, or spill if no managed thread is registered.
+ */
+static void postEvent(CallbackEventQueue::Event&& event)
+{
+    if (isCallbackEventConsumer()) {
+        acceptPostedEvents(true);
+        callbackEvents.push(std::move(event));
+        return;
+    }
+    const auto BACKOFF = std::chrono::milliseconds(1);
+    for (;;) {
+        if (spilling.load(std::memory_order_acquire) && spillEvent(event, false)) {
+            break;
+        }
+        if (postedEvents.tryPush(std::move(event))) {
+            break;
+        }
+        if (consumerThread.load(std::memory_order_relaxed) == std::thread::id()) {
+            spillEvent(event, true);
+            break;
+        }
+        std::unique_lock<std::mutex> lock(waitMutex);
+        waitingProducers.fetch_add(1, std::memory_order_acq_rel);
+        spaceFreed.wait_for(lock, BACKOFF);
+        waitingProducers.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    notifyConsumer();
+}
 
 void enqueueCallback(const CallbackBuffer* event)
 {
-    callbackEventsQueue.push_back(Event_CallCallback);
-    callbackCallSubqueue.push_back(*event);
+    postEvent({ Event_CallCallback, 0, *event });
 }
 
 void holdManagedCallbackResource(InteropInt32 resourceId)
 {
-    callbackEventsQueue.push_back(Event_HoldManagedResource);
-    callbackResourceSubqueue.push_back(resourceId);
+    postEvent({ Event_HoldManagedResource, resourceId, {} });
 }
 
 void releaseManagedCallbackResource(InteropInt32 resourceId)
 {
-    callbackEventsQueue.push_back(Event_ReleaseManagedResource);
-    callbackResourceSubqueue.push_back(resourceId);
+    postEvent({ Event_ReleaseManagedResource, resourceId, {} });
 }
 
-KInt impl_CheckCallbackEvent(KByte* buffer, KInt size)
+// Callers check the size first, so a failure means a broken event and is fatal
+static void copyBytes(KByte* dest, size_t destSize, const void* src, size_t count)
 {
-    KByte* result = (KByte*)buffer;
-    if (needReleaseFront) {
-        switch (callbackEventsQueue.front()) {
-            case Event_CallCallback:
-                callbackCallSubqueue.front().resourceHolder.release();
-                callbackCallSubqueue.pop_front();
-                break;
-            case Event_HoldManagedResource:
-            case Event_ReleaseManagedResource:
-                callbackResourceSubqueue.pop_front();
-                break;
-            default:
-                INTEROP_FATAL("Unknown event kind");
-        }
-        callbackEventsQueue.pop_front();
-        needReleaseFront = false;
+    if (count > destSize) {
+        INTEROP_FATAL("Callback event does not fit: %zu > %zu", count, destSize);
+        return;
     }
-    if (callbackEventsQueue.empty()) {
-        return 0;
-    }
-    const CallbackEventKind frontEventKind = callbackEventsQueue.front();
 #ifdef __STDC_LIB_EXT1__
-    errno_t res = memcpy_s(result, size, &frontEventKind, 4);
-    if (res != EOK) {
-        return 0;
+    if (memcpy_s(dest, destSize, src, count) != EOK) {
+        INTEROP_FATAL("Cannot copy callback event");
     }
 #else
-    memcpy(result, &frontEventKind, 4);
+    memcpy(dest, src, count);
 #endif
+}
 
-    switch (frontEventKind) {
+static const KByte* eventPayload(const CallbackEventQueue::Event& event, InteropInt32& length)
+{
+    switch (event.kind) {
         case Event_CallCallback:
-#ifdef __STDC_LIB_EXT1__
-            errno_t res = memcpy_s(result + 4, size, callbackCallSubqueue.front().buffer,
-                sizeof(CallbackBuffer::buffer));
-            if (res != EOK) {
-                return 0;
-            }
-#else
-            memcpy(result + 4, callbackCallSubqueue.front().buffer, sizeof(CallbackBuffer::buffer));
-#endif
-            break;
+            length = sizeof(CallbackBuffer::buffer);
+            return event.callback.buffer;
         case Event_HoldManagedResource:
-        case Event_ReleaseManagedResource: {
-            const InteropInt32 resourceId = callbackResourceSubqueue.front();
-#ifdef __STDC_LIB_EXT1__
-            errno_t res = memcpy_s(result + 4, size, &frontEventKind, 4);
-            if (res != EOK) {
-                return 0;
-            }
-#else
-            memcpy(result + 4, &resourceId, 4);
-#endif
-            break;
-        }
+        case Event_ReleaseManagedResource:
+            length = sizeof(event.resourceId);
+            return reinterpret_cast<const KByte*>(&event.resourceId);
         default:
             INTEROP_FATAL("Unknown event kind");
+            length = 0;
+            return nullptr;
+    }
+}
+
+/*
+ * Writes the next event as [kind, payload]. Returns 1, 0 when there is none, or -1
+ * when the buffer is too small for it, the event then stays queued.
+ */
+KInt impl_CheckCallbackEvent(KByte* buffer, KInt size)
+{
+    ensureCallbackEventConsumer();
+    callbackEvents.releaseHandedOut();
+    acceptPostedEvents();
+    if (callbackEvents.empty()) {
+        return 0;
     }
-    needReleaseFront = true;
+    auto& event = callbackEvents.next();
+    InteropInt32 length = 0;
+    const KByte* payload = eventPayload(event, length);
+    const InteropInt32 kind = event.kind;
+    if (size < static_cast<KInt>(sizeof(kind)) + length) {
+        return -1;
+    }
+    copyBytes(buffer, size, &kind, sizeof(kind));
+    copyBytes(buffer + sizeof(kind), size - sizeof(kind), payload, length);
+    callbackEvents.handOut();
     return 1;
 }
 KOALA_INTEROP_2(CheckCallbackEvent, KInt, KByte*, KInt)
 
+/*
+ * Writes as many pending events as fit as [kind, payload length, payload] records.
+ * Returns the number of records, or -1 if not even the first event fits. Events of
+ * the previous drain or check are released first.
+ */
+KInt impl_DrainCallbackEvents(KByte* buffer, KInt size)
+{
+    ensureCallbackEventConsumer();
+    callbackEvents.releaseHandedOut();
+    acceptPostedEvents();
+    KInt written = 0;
+    KInt offset = 0;
+    while (!callbackEvents.empty()) {
+        auto& event = callbackEvents.next();
+        InteropInt32 length = 0;
+        const KByte* payload = eventPayload(event, length);
+        const InteropInt32 header[] = { event.kind, length };
+        if (size - offset < static_cast<KInt>(sizeof(header)) + length) {
+            return written == 0 ? -1 : written;
+        }
+        copyBytes(buffer + offset, size - offset, header, sizeof(header));
+        copyBytes(buffer + offset + sizeof(header), size - offset - sizeof(header), payload, length);
+        offset += sizeof(header) + length;
+        callbackEvents.handOut();
+        written++;
+    }
+    return written;
+}
+KOALA_INTEROP_2(DrainCallbackEvents, KInt, KByte*, KInt)
+
+// Blocks the managed thread until events are posted or the timeout expires, returns 1 if any are pending
+KInt impl_WaitCallbackEvents(KInt timeoutMs)
+{
+    ensureCallbackEventConsumer();
+    acceptPostedEvents();
+    if (!callbackEvents.empty()) {
+        return 1;
+    }
+    std::unique_lock<std::mutex> lock(waitMutex);
+    waitingConsumers.fetch_add(1, std::memory_order_acq_rel);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    eventsPosted.wait_for(lock, std::chrono::milliseconds(timeoutMs), []() {
+        return postedEvents.hasEvents() || spilling.load(std::memory_order_acquire);
+    });
+    waitingConsumers.fetch_sub(1, std::memory_order_acq_rel);
+    lock.unlock();
+    acceptPostedEvents();
+    return callbackEvents.empty() ? 0 : 1;
+}
+KOALA_INTEROP_1(WaitCallbackEvents, KInt, KInt)
+
+void impl_RegisterCallbackEventConsumer()
+{
+    registerCallbackEventConsumer();
+}
+KOALA_INTEROP_V0(RegisterCallbackEventConsumer)
+
 void impl_ReleaseCallbackResource(InteropInt32 resourceId)
 {
+    ensureCallbackEventConsumer();
     releaseManagedCallbackResource(resourceId);
 }
 KOALA_INTEROP_V1(ReleaseCallbackResource, KInt)
 
 void impl_HoldCallbackResource(InteropInt32 resourceId)
 {
+    ensureCallbackEventConsumer();
     holdManagedCallbackResource(resourceId);
 }
 KOALA_INTEROP_V1(HoldCallbackResource, KInt)
@@ -51,5 +51,9 @@ enum CallbackEventKind {
 void enqueueCallback(const CallbackBuffer* event);
 void holdManagedCallbackResource(InteropInt32 resourceId);
 void releaseManagedCallbackResource(InteropInt32 resourceId);
+// Marks the calling thread as the managed one draining events, call at init before events are posted
+void registerCallbackEventConsumer();
+// Called once per batch of events posted while the managed thread is not draining, from the posting thread
+void setCallbackEventWakeup(void (*hook)(void* context), void* context);
 
 #endif
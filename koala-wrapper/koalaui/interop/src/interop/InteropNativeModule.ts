@@ -37,7 +37,12 @@ export class InteropNativeModule {
     public static _NativeLog(str1: string): void { throw "method not loaded" }
     public static _Utf8ToString(data: KUint8ArrayPtr, offset: int32, length: int32): string { throw "method not loaded" }
     public static _StdStringToString(cstring: KPointer): string { throw "method not loaded" }
+    /** Writes the next event as [kind, payload], returns 1, 0 if there is none or -1 if it does not fit */
     public static _CheckCallbackEvent(buffer: KUint8ArrayPtr, bufferLength: int32): int32 { throw "method not loaded" }
+    /** Fills the buffer with [kind, length, payload] records of pending events, returns their number or -1 if none fits */
+    public static _DrainCallbackEvents(buffer: KUint8ArrayPtr, bufferLength: int32): int32 { throw "method not loaded" }
+    public static _WaitCallbackEvents(timeoutMs: int32): int32 { throw "method not loaded" }
+    public static _RegisterCallbackEventConsumer(): void { throw "method not loaded" }
     public static _HoldCallbackResource(resourceId: int32): void { throw "method not loaded" }
     public static _ReleaseCallbackResource(resourceId: int32): void { throw "method not loaded" }
     public static _CallCallback(callbackKind: int32, args: Uint8Array, argsSize: int32): void { throw "method not loaded" }
@@ -56,4 +61,6 @@ export class InteropNativeModule {
 
 export function loadInteropNativeModule() {
     loadNativeModuleLibrary("InteropNativeModule", InteropNativeModule)
+    // Events posted from other threads are drained by this one
+    InteropNativeModule._RegisterCallbackEventConsumer()
 }
\ No newline at end of file
@@ -20,6 +20,8 @@
 #include "es2panda_lib.h"
 #include "common-interop.h"
 #include "stdexcept"
+#include <cstdlib>
+#include <memory>
 #include <string>
 #include <iostream>
 #include <vector>
@@ -34,6 +36,15 @@ char* getStringCopy(const KStringPtr& ptr);
 
 KUInt unpackUInt(const KByte* bytes);
 
+/*
+ * Decodes the first `count` strings of a KStringArray ([count, (length, bytes)...]) into
+ * a single allocation: the pointer table followed by the NUL terminated strings.
+ * Release it with free(), or hold it in a StringArrayHolder.
+ */
+const char** decodeStringArray(KStringArray data, std::size_t count);
+
+using StringArrayHolder = std::unique_ptr<const char*[], decltype(&free)>;
+
 es2panda_ContextState intToState(KInt state);
 
 #endif // COMMON_H_
\ No newline at end of file
@@ -517,19 +517,8 @@ KOALA_INTEROP_2(FormOutputPathForFile, KNativePointer, KNativePointer, KStringPt
 KNativePointer impl_CreateContextSimultaneousMode(KNativePointer configPtr, KInt fileNamesCount, KStringArray fileNames)
 {
     auto config = reinterpret_cast<es2panda_Config *>(configPtr);
-    const std::size_t headerLen = 4;
-    const char **argv = new const char *[static_cast<unsigned int>(fileNamesCount)];
-    std::size_t position = headerLen;
-    std::size_t strLen;
-    for (std::size_t i = 0; i < static_cast<std::size_t>(fileNamesCount); ++i) {
-        strLen = unpackUInt(fileNames + position);
-        position += headerLen;
-        argv[i] = strdup(std::string(reinterpret_cast<const char *>(fileNames + position), strLen).c_str());
-        position += strLen;
-    }
-    auto context = GetImpl()->CreateContextSimultaneousMode(config, fileNamesCount, argv);
-    delete[] argv;
-    return context;
+    StringArrayHolder argv(decodeStringArray(fileNames, static_cast<std::size_t>(fileNamesCount)), &free);
+    return GetImpl()->CreateContextSimultaneousMode(config, fileNamesCount, argv.get());
 }
 KOALA_INTEROP_3(CreateContextSimultaneousMode, KNativePointer, KNativePointer, KInt, KStringArray)
 
@@ -567,53 +556,13 @@ KNativePointer impl_CreateTsDeclgen(KNativePointer contextPtr, KUInt fileNamesCo
                                      KBoolean isolated, KStringPtr &recordFile, KBoolean genAnnotations)
 {
     auto context = reinterpret_cast<es2panda_Context *>(contextPtr);
-    const std::size_t headerLen = 4;
     const auto count = static_cast<std::size_t>(fileNamesCount);
-
-    std::vector<std::string> inputFilesStr;
-    std::vector<std::string> outputDeclEtsStr;
-    std::vector<std::string> outputEtsStr;
-
-    inputFilesStr.reserve(count);
-    outputDeclEtsStr.reserve(count);
-    outputEtsStr.reserve(count);
-
-    std::size_t inputPosition = headerLen;
-    std::size_t declPosition = headerLen;
-    std::size_t etsPosition = headerLen;
-
-    for (std::size_t i = 0; i < count; ++i) {
-        std::size_t strLen = unpackUInt(inputFiles + inputPosition);
-        inputPosition += headerLen;
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-        inputFilesStr.emplace_back(reinterpret_cast<const char *>(inputFiles + inputPosition), strLen);
-        inputPosition += strLen;
-
-        strLen = unpackUInt(outputDeclEts + declPosition);
-        declPosition += headerLen;
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-        outputDeclEtsStr.emplace_back(reinterpret_cast<const char *>(outputDeclEts + declPosition), strLen);
-        declPosition += strLen;
-
-        strLen = unpackUInt(outputEts + etsPosition);
-        etsPosition += headerLen;
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-        outputEtsStr.emplace_back(reinterpret_cast<const char *>(outputEts + etsPosition), strLen);
-        etsPosition += strLen;
-    }
-
-    std::vector<const char *> inputFilesList(count);
-    std::vector<const char *> outputDeclEtsList(count);
-    std::vector<const char *> outputEtsList(count);
-
-    for (std::size_t i = 0; i < count; ++i) {
-        inputFilesList[i] = inputFilesStr[i].c_str();
-        outputDeclEtsList[i] = outputDeclEtsStr[i].c_str();
-        outputEtsList[i] = outputEtsStr[i].c_str();
-    }
+    StringArrayHolder inputFilesList(decodeStringArray(inputFiles, count), &free);
+    StringArrayHolder outputDeclEtsList(decodeStringArray(outputDeclEts, count), &free);
+    StringArrayHolder outputEtsList(decodeStringArray(outputEts, count), &free);
 
     return static_cast<KNativePointer>(GetImpl()->CreateTsDeclgen(
-        context, fileNamesCount, inputFilesList.data(), outputDeclEtsList.data(), outputEtsList.data(),
+        context, fileNamesCount, inputFilesList.get(), outputDeclEtsList.get(), outputEtsList.get(),
         exportAll != 0, isolated != 0, recordFile.data(), genAnnotations != 0));
 }
 KOALA_INTEROP_9(CreateTsDeclgen, KNativePointer, KNativePointer, KUInt, KStringArray,
@@ -907,16 +856,7 @@ KNativePointer impl_CreateDiagnosticInfo(KNativePointer context, KNativePointer
     const auto _context = reinterpret_cast<es2panda_Context*>(context);
     const auto _kind = reinterpret_cast<es2panda_DiagnosticKind*>(kind);
     const auto _pos = reinterpret_cast<es2panda_SourcePosition *>(pos);
-    const std::size_t headerLen = 4;
-    const char** _args = new const char*[argc];
-    std::size_t position = headerLen;
-    std::size_t strLen;
-    for (std::size_t i = 0; i < static_cast<std::size_t>(argc); ++i) {
-        strLen = unpackUInt(argsPtr + position);
-        position += headerLen;
-        _args[i] = strdup(std::string(reinterpret_cast<const char*>(argsPtr + position), strLen).c_str());
-        position += strLen;
-    }
+    const char** _args = decodeStringArray(argsPtr, static_cast<std::size_t>(argc));
     return GetImpl()->CreateDiagnosticInfo(_context, _kind, _args, argc, _pos);
 }
 KOALA_INTEROP_5(CreateDiagnosticInfo, KNativePointer, KNativePointer, KNativePointer,
@@ -929,16 +869,7 @@ KNativePointer impl_CreateSuggestionInfo(KNativePointer context, KNativePointer
     const auto _context = reinterpret_cast<es2panda_Context*>(context);
     const auto _kind = reinterpret_cast<es2panda_DiagnosticKind *>(kind);
     const auto _range = reinterpret_cast<es2panda_SourceRange *>(range);
-    const std::size_t headerLen = 4;
-    const char** _args = new const char*[argc];
-    std::size_t position = headerLen;
-    std::size_t strLen;
-    for (std::size_t i = 0; i < static_cast<std::size_t>(argc); ++i) {
-        strLen = unpackUInt(argsPtr + position);
-        position += headerLen;
-        _args[i] = strdup(std::string(reinterpret_cast<const char*>(argsPtr + position), strLen).c_str());
-        position += strLen;
-    }
+    const char** _args = decodeStringArray(argsPtr, static_cast<std::size_t>(argc));
     const auto _substitutionCode = getStringCopy(substitutionCode);
     const auto _title = getStringCopy(title);
     return GetImpl()->CreateSuggestionInfo(_context, _kind, _args, argc, _substitutionCode, _title, _range);
@@ -952,16 +883,7 @@ void impl_LogDiagnostic(KNativePointer context, KNativePointer kind, KStringArra
     auto&& _context_ = reinterpret_cast<es2panda_Context *>(context);
     auto&& _kind_ = reinterpret_cast<es2panda_DiagnosticKind *>(kind);
     auto&& _pos_ = reinterpret_cast<es2panda_SourcePosition *>(pos);
-    const std::size_t headerLen = 4;
-    const char** argv = new const char*[argc];
-    std::size_t position = headerLen;
-    std::size_t strLen;
-    for (std::size_t i = 0; i < static_cast<std::size_t>(argc); ++i) {
-        strLen = unpackUInt(argvPtr + position);
-        position += headerLen;
-        argv[i] = strdup(std::string(reinterpret_cast<const char*>(argvPtr + position), strLen).c_str());
-        position += strLen;
-    }
+    const char** argv = decodeStringArray(argvPtr, static_cast<std::size_t>(argc));
     GetImpl()->LogDiagnostic(_context_, _kind_, argv, argc, _pos_);
 }
 KOALA_INTEROP_V5(LogDiagnostic, KNativePointer, KNativePointer, KStringArray, KInt, KNativePointer);
@@ -15,6 +15,9 @@
 
 #include <common.h>
 
+#include <algorithm>
+#include <new>
+
 using std::string, std::cout, std::endl, std::vector;
 
 static es2panda_Impl *impl = nullptr;
@@ -136,6 +139,37 @@ inline KUInt unpackUInt(const KByte* bytes) {
     );
 }
 
+const char** decodeStringArray(KStringArray data, std::size_t count)
+{
+    const std::size_t headerLen = 4;
+    std::size_t tableSize = sizeof(const char*) * (count + 1);
+    std::size_t bufferSize = tableSize;
+    std::size_t position = headerLen;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t strLen = unpackUInt(data + position);
+        bufferSize += strLen + 1;
+        position += headerLen + strLen;
+    }
+
+    auto table = static_cast<const char**>(malloc(bufferSize));
+    if (table == nullptr) {
+        throw std::bad_alloc();
+    }
+    char* payload = reinterpret_cast<char*>(table) + tableSize;
+    position = headerLen;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t strLen = unpackUInt(data + position);
+        position += headerLen;
+        std::copy_n(reinterpret_cast<const char*>(data + position), strLen, payload);
+        payload[strLen] = '\0';
+        table[i] = payload;
+        payload += strLen + 1;
+        position += strLen;
+    }
+    table[count] = nullptr;
+    return table;
+}
+
 void impl_MemInitialize()
 {
     GetImpl()->MemInitialize();
@@ -153,18 +187,8 @@ KNativePointer impl_CreateGlobalContext(KNativePointer configPtr, KStringArray e
 {
     auto config = reinterpret_cast<es2panda_Config*>(configPtr);
 
-    const std::size_t headerLen = 4;
-
-    const char** externalFileList = new const char* [fileNum];
-    std::size_t position = headerLen;
-    std::size_t strLen;
-    for (std::size_t i = 0; i < static_cast<std::size_t>(fileNum); ++i) {
-        strLen = unpackUInt(externalFileListPtr + position);
-        position += headerLen;
-        externalFileList[i] = strdup(std::string(
-            reinterpret_cast<const char*>(externalFileListPtr + position), strLen).c_str());
-        position += strLen;
-    }
+    // Kept alive for the global context
+    const char** externalFileList = decodeStringArray(externalFileListPtr, static_cast<std::size_t>(fileNum));
 
     return GetImpl()->CreateGlobalContext(config, externalFileList, fileNum, lspUsage);
 }
@@ -187,17 +211,8 @@ KNativePointer impl_CreateCacheContextFromFile(KNativePointer configPtr, KString
 KOALA_INTEROP_4(CreateCacheContextFromFile, KNativePointer, KNativePointer, KStringPtr, KNativePointer, KBoolean)
 
 KNativePointer impl_CreateConfig(KInt argc, KStringArray argvPtr) {
-    const std::size_t headerLen = 4;
-
-    const char** argv = new const char*[argc];
-    std::size_t position = headerLen;
-    std::size_t strLen;
-    for (std::size_t i = 0; i < static_cast<std::size_t>(argc); ++i) {
-        strLen = unpackUInt(argvPtr + position);
-        position += headerLen;
-        argv[i] = strdup(std::string(reinterpret_cast<const char*>(argvPtr + position), strLen).c_str());
-        position += strLen;
-    }
+    // Kept alive for the config
+    const char** argv = decodeStringArray(argvPtr, static_cast<std::size_t>(argc));
     return GetImpl()->CreateConfig(argc, argv);
 }
 KOALA_INTEROP_2(CreateConfig, KNativePointer, KInt, KStringArray)